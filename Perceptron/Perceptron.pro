@@ -27,15 +27,15 @@ CONFIG += c++14
 #CONFIG+= static
 #msvc:QMAKE_CXXFLAG += /std:c++17
 
+# the network core builds without Qt and is shared with the benchmark
+include(core.pri)
+
 SOURCES += \
         main.cpp \
-        perceptronwindow.cpp \
-    network.cpp
+        perceptronwindow.cpp
 
 HEADERS += \
-        perceptronwindow.h \
-        neuron.h \
-    network.h
+        perceptronwindow.h
 
 FORMS += \
         perceptronwindow.ui
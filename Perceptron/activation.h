@@ -0,0 +1,112 @@
+#ifndef ACTIVATION_H
+#define ACTIVATION_H
+#include <algorithm>
+#include <functional>
+#include "kernels.h"
+#include "neuron.h"
+// Statically known activation functions. Hot loops are instantiated once per
+// policy so the activation inlines into them, anything else goes through the
+// Custom policy wrapping std::function.
+namespace Neuron {
+enum class Activation { Heaviside, Sign, Logistic, Tanh, Custom };
+
+// Parameters of the built in activations. Every model owns its own copy and
+// the policies capture them by value, so models with different parameters
+// can train side by side.
+struct ActivationParameters {
+  // steepness of the logistic function
+  double beta{1.0};
+  // threshold of every built in activation, which computes f(sum - theta)
+  double theta{0.0};
+};
+
+namespace Policy {
+// The built in policies take the sum of a neuron and apply their function to
+// sum - theta. The step functions have no useful derivative, training treats
+// them as pass-through like the classic perceptron rule does.
+struct Heaviside {
+  double theta;
+
+  double activate(double in) const { return heaviside(in - theta); }
+  double derivative(double) const { return 1.0; }
+  void activate(const double *in, double *out, size_t size) const {
+    const double threshold = theta;
+    std::transform(in, in + size, out, [threshold](double value) {
+      return value >= threshold ? 1.0 : 0.0;
+    });
+  }
+};
+
+struct Sign {
+  double theta;
+
+  double activate(double in) const { return sign(in - theta); }
+  double derivative(double) const { return 1.0; }
+  void activate(const double *in, double *out, size_t size) const {
+    const double threshold = theta;
+    std::transform(in, in + size, out, [threshold](double value) {
+      return static_cast<double>((value > threshold) - (value < threshold));
+    });
+  }
+};
+
+struct Logistic {
+  double beta;
+  double theta;
+
+  double activate(double in) const { return logistic(in - theta, beta); }
+  double derivative(double in) const {
+    return logisticDerivative(in - theta, beta);
+  }
+  void activate(const double *in, double *out, size_t size) const {
+    Kernels::logistic(in, out, size, beta, theta);
+  }
+};
+
+struct Tanh {
+  double theta;
+
+  double activate(double in) const { return hypertan(in - theta); }
+  double derivative(double in) const { return hypertanDerivative(in - theta); }
+  void activate(const double *in, double *out, size_t size) const {
+    Kernels::hypertan(in, out, size, theta);
+  }
+};
+
+struct Custom {
+  const std::function<double(double)> &function;
+  const std::function<double(double)> &functionDerivative;
+
+  double activate(double in) const { return function(in); }
+  double derivative(double in) const { return functionDerivative(in); }
+  void activate(const double *in, double *out, size_t size) const {
+    std::transform(in, in + size, out, function);
+  }
+};
+}  // namespace Policy
+
+// Calls body with the policy matching activation and parameters, custom
+// activations fall back to the given std::function pair and ignore the
+// parameters.
+template <typename Body>
+decltype(auto) dispatch(Activation activation,
+                        const ActivationParameters &parameters,
+                        const std::function<double(double)> &function,
+                        const std::function<double(double)> &derivative,
+                        Body &&body) {
+  switch (activation) {
+    case Activation::Heaviside:
+      return body(Policy::Heaviside{parameters.theta});
+    case Activation::Sign:
+      return body(Policy::Sign{parameters.theta});
+    case Activation::Logistic:
+      return body(Policy::Logistic{parameters.beta, parameters.theta});
+    case Activation::Tanh:
+      return body(Policy::Tanh{parameters.theta});
+    case Activation::Custom:
+      break;
+  }
+  return body(Policy::Custom{function, derivative});
+}
+}  // namespace Neuron
+#endif  // ACTIVATION_H
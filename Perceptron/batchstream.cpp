@@ -0,0 +1,111 @@
+#include "batchstream.h"
+
+#include <algorithm>
+#include <utility>
+
+NeuralNetwork::BatchStream::BatchStream(std::unique_ptr<DatasetReader> reader,
+                                        size_t batch_size, size_t first_row,
+                                        size_t last_row)
+    : reader(std::move(reader)),
+      input_count(this->reader->inputCount()),
+      output_count(this->reader->outputCount()),
+      batch_size(std::max<size_t>(batch_size, 1)),
+      first(std::min(first_row, std::min(last_row, this->reader->rows()))),
+      last(std::min(last_row, this->reader->rows())),
+      cursor(first) {
+  worker = std::thread(&BatchStream::prefetch, this);
+}
+
+NeuralNetwork::BatchStream::~BatchStream() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  space.notify_all();
+  worker.join();
+}
+
+const NeuralNetwork::Batch *NeuralNetwork::BatchStream::next() {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (holding) {
+    filled[consume] = false;
+    consume ^= 1;
+    holding = false;
+    space.notify_all();
+  }
+  if (finished) return nullptr;
+  ready.wait(lock, [this] { return filled[consume] || error; });
+  if (!filled[consume]) {
+    finished = true;
+    std::rethrow_exception(std::exchange(error, nullptr));
+  }
+  if (!buffers[consume].rows()) {
+    filled[consume] = false;
+    finished = true;
+    return nullptr;
+  }
+  holding = true;
+  return &buffers[consume];
+}
+
+void NeuralNetwork::BatchStream::rewind() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++pass;
+    cursor = first;
+    produce = 0;
+    consume = 0;
+    filled[0] = false;
+    filled[1] = false;
+    holding = false;
+    finished = false;
+    exhausted = false;
+    error = nullptr;
+  }
+  space.notify_all();
+}
+
+// Fills the free buffer with the next batch outside the lock. The consumer
+// only ever touches filled buffers, and a rewind() meanwhile just makes the
+// batch stale, so the reader needs no locking of its own. An empty batch
+// marks the end of the pass.
+void NeuralNetwork::BatchStream::prefetch() {
+  size_t reader_position = SIZE_MAX;
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    space.wait(lock, [this] {
+      return stopping || (!exhausted && !filled[produce]);
+    });
+    if (stopping) return;
+    const size_t current_pass = pass;
+    const size_t slot = produce;
+    const size_t position = cursor;
+    lock.unlock();
+
+    Batch &batch = buffers[slot];
+    std::exception_ptr failure;
+    size_t rows = 0;
+    try {
+      if (position != reader_position) reader->seek(position);
+      rows = reader->read(std::min(batch_size, last - position), batch.inputs,
+                          batch.outputs);
+      reader_position = position + rows;
+    } catch (...) {
+      failure = std::current_exception();
+      reader_position = SIZE_MAX;
+    }
+
+    lock.lock();
+    if (pass != current_pass) continue;
+    if (failure) {
+      error = failure;
+      exhausted = true;
+    } else {
+      cursor = position + rows;
+      filled[slot] = true;
+      produce ^= 1;
+      exhausted = !rows;
+    }
+    ready.notify_all();
+  }
+}
@@ -0,0 +1,75 @@
+#ifndef BATCHSTREAM_H
+#define BATCHSTREAM_H
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "dataset.h"
+#include "matrix.h"
+namespace NeuralNetwork {
+// samples of one batch, one per row
+struct Batch {
+  Matrix inputs;
+  Matrix outputs;
+  size_t rows() const { return inputs.rows(); }
+};
+
+// Streams the samples [first_row, last_row) of a reader in batches. A
+// background thread reads ahead into two alternating buffers, so parsing or
+// paging in the next batch overlaps with the work on the current one. Reader
+// errors are rethrown by next().
+class BatchStream {
+ public:
+  BatchStream(std::unique_ptr<DatasetReader> reader, size_t batch_size,
+              size_t first_row = 0, size_t last_row = SIZE_MAX);
+  ~BatchStream();
+  BatchStream(const BatchStream &) = delete;
+  BatchStream &operator=(const BatchStream &) = delete;
+
+  size_t inputCount() const { return input_count; }
+  size_t outputCount() const { return output_count; }
+  // samples in one pass
+  size_t rows() const { return last - first; }
+  size_t batchSize() const { return batch_size; }
+
+  // the next batch of the pass or nullptr once it is exhausted, the batch
+  // stays valid until the following next() or rewind()
+  const Batch *next();
+  // starts a new pass at the first sample, a new stream starts one itself
+  void rewind();
+
+ private:
+  void prefetch();
+
+  std::unique_ptr<DatasetReader> reader;
+  const size_t input_count;
+  const size_t output_count;
+  const size_t batch_size;
+  const size_t first;
+  const size_t last;
+
+  Batch buffers[2];
+  bool filled[2]{false, false};
+  size_t produce{0};
+  size_t consume{0};
+  // the consumer still uses buffers[consume]
+  bool holding{false};
+  // the consumer has seen the end of the pass
+  bool finished{false};
+  // the prefetch thread has reached the end of the pass
+  bool exhausted{false};
+  // sample the prefetch thread reads next
+  size_t cursor;
+  // bumped by rewind(), batches read for an older pass are dropped
+  size_t pass{0};
+  bool stopping{false};
+  std::exception_ptr error;
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::condition_variable space;
+  std::thread worker;
+};
+}  // namespace NeuralNetwork
+#endif  // BATCHSTREAM_H
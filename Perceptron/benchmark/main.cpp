@@ -0,0 +1,462 @@
+// Headless benchmark of the network core. Sweeps topologies (layers x
+// neurons x inputs) and thread counts and reports throughput, time per layer
+// and heap allocations per step as a table, CSV or JSON.
+//
+//   benchmark --layers 1,2 --neurons 64,512 --inputs 16 --threads 1,4
+//             --samples 4096 --batch 64 --epochs 2 --format json
+//
+// Built with CONFIG += profiling, --trace writes a Chrome trace of every
+// timed scope to the given file and a per-layer summary to stderr.
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "kernels.h"
+#include "network.h"
+#include "neuron.h"
+#include "perceptronbatch.h"
+#include "profiler.h"
+#include "staticnetwork.h"
+
+#ifdef NEURALNETWORK_PROFILING
+// the profiler already counts the allocations of the process
+namespace {
+size_t heapAllocations() {
+  return static_cast<size_t>(NeuralNetwork::Profiling::allocations());
+}
+}  // namespace
+#else
+namespace {
+std::atomic<size_t> allocations{0};
+
+size_t heapAllocations() { return allocations.load(); }
+}  // namespace
+
+// every heap allocation of the process goes through here, which is how the
+// allocations per step are counted. GCC pairs the inlined new with free and
+// warns, the pairing is intended.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void *operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *block = std::malloc(size ? size : 1)) return block;
+  throw std::bad_alloc();
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *block) noexcept { std::free(block); }
+void operator delete[](void *block) noexcept { std::free(block); }
+void operator delete(void *block, size_t) noexcept { std::free(block); }
+void operator delete[](void *block, size_t) noexcept { std::free(block); }
+#endif
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  std::vector<size_t> layers{1, 2};
+  std::vector<size_t> neurons{16, 128, 512};
+  std::vector<size_t> inputs{16};
+  std::vector<size_t> threads{1, std::max(1u, std::thread::hardware_concurrency())};
+  size_t outputs{4};
+  size_t samples{2048};
+  size_t batch{64};
+  size_t epochs{2};
+  double min_seconds{0.2};
+  std::string format{"table"};
+  std::string trace;
+};
+
+struct Result {
+  std::string name;
+  size_t layers;
+  size_t neurons;
+  size_t inputs;
+  size_t threads;
+  size_t batch;
+  double samples_per_second;
+  double ns_per_layer;
+  double allocations_per_step;
+};
+
+std::vector<size_t> parseList(const char *text) {
+  std::vector<size_t> values;
+  std::stringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) values.push_back(std::stoul(item));
+  }
+  return values;
+}
+
+bool parseOptions(int argc, char *argv[], Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string name = argv[i];
+    if (name == "--help" || i + 1 >= argc) return false;
+    const char *value = argv[++i];
+    if (name == "--layers") {
+      options.layers = parseList(value);
+    } else if (name == "--neurons") {
+      options.neurons = parseList(value);
+    } else if (name == "--inputs") {
+      options.inputs = parseList(value);
+    } else if (name == "--threads") {
+      options.threads = parseList(value);
+    } else if (name == "--outputs") {
+      options.outputs = std::stoul(value);
+    } else if (name == "--samples") {
+      options.samples = std::stoul(value);
+    } else if (name == "--batch") {
+      options.batch = std::stoul(value);
+    } else if (name == "--epochs") {
+      options.epochs = std::stoul(value);
+    } else if (name == "--min-time") {
+      options.min_seconds = std::stod(value);
+    } else if (name == "--format") {
+      options.format = value;
+    } else if (name == "--trace" && NeuralNetwork::Profiling::available) {
+      options.trace = value;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+double seconds(Clock::time_point since) {
+  return std::chrono::duration<double>(Clock::now() - since).count();
+}
+
+// repeats step until at least min_seconds passed, returns seconds per step
+// and the allocations of a single step
+std::pair<double, double> measure(const std::function<void()> &step,
+                                  double min_seconds) {
+  step();
+  size_t steps = 0;
+  const size_t allocated = heapAllocations();
+  const auto start = Clock::now();
+  do {
+    step();
+    ++steps;
+  } while (seconds(start) < min_seconds);
+  const double elapsed = seconds(start);
+  return {elapsed / steps,
+          static_cast<double>(heapAllocations() - allocated) / steps};
+}
+
+void generate(size_t samples, size_t inputs, size_t outputs,
+              std::vector<std::vector<double>> &input,
+              std::vector<std::vector<double>> &output) {
+  std::mt19937 engine(42);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  input.assign(samples, std::vector<double>(inputs));
+  output.assign(samples, std::vector<double>(outputs, 0.0));
+  for (size_t i = 0; i < samples; ++i) {
+    for (auto &value : input[i]) value = uniform(engine);
+    output[i][i % outputs] = 1.0;
+  }
+}
+
+void benchmarkTopology(const Options &options, size_t layers, size_t neurons,
+                       size_t inputs, std::vector<Result> &results) {
+  NeuralNetwork::NeuralNetworkBuilder builder;
+  auto network = builder.setInputNeurons(inputs)
+                     .setOutputNeurons(options.outputs)
+                     .setIntermediateLayers(layers)
+                     .setIntermediateNeurons(neurons)
+                     .setActivation(Neuron::Activation::Logistic)
+                     .build();
+  std::vector<std::vector<double>> input;
+  std::vector<std::vector<double>> output;
+  generate(options.samples, inputs, options.outputs, input, output);
+  const double layer_count = static_cast<double>(network->layerCount());
+
+  std::vector<double> result(options.outputs);
+  size_t sample = 0;
+  auto simulate = measure(
+      [&]() {
+        network->simulate(input[sample].data(), result.data());
+        sample = (sample + 1) % input.size();
+      },
+      options.min_seconds);
+  results.push_back({"simulate", layers, neurons, inputs, 1, 1,
+                     1.0 / simulate.first, simulate.first * 1e9 / layer_count,
+                     simulate.second});
+
+  NeuralNetwork::Matrix batch(options.batch, inputs);
+  NeuralNetwork::Matrix predictions;
+  for (size_t b = 0; b < options.batch; ++b) {
+    std::copy(input[b % input.size()].begin(), input[b % input.size()].end(),
+              batch.row(b));
+  }
+  auto predict = measure([&]() { network->predictBatch(batch, predictions); },
+                         options.min_seconds);
+  results.push_back({"predictBatch", layers, neurons, inputs, 1, options.batch,
+                     options.batch / predict.first,
+                     predict.first * 1e9 / layer_count / options.batch,
+                     predict.second});
+
+  const double epoch_samples =
+      static_cast<double>(input.size() * options.epochs);
+  auto online = measure(
+      [&]() { network->train(input, output, 0.01, 0.0, options.epochs); }, 0.0);
+  results.push_back({"train", layers, neurons, inputs, 1, 1,
+                     epoch_samples / online.first,
+                     online.first * 1e9 / layer_count / epoch_samples,
+                     online.second / epoch_samples});
+
+  for (size_t threads : options.threads) {
+    network->setThreadCount(threads);
+    auto batched = measure(
+        [&]() {
+          network->train(input, output, 0.01, 0.0, options.epochs,
+                         options.batch);
+        },
+        0.0);
+    results.push_back({"trainBatched", layers, neurons, inputs, threads,
+                       options.batch, epoch_samples / batched.first,
+                       batched.first * 1e9 / layer_count / epoch_samples,
+                       batched.second / epoch_samples});
+  }
+  network->setThreadCount(1);
+}
+
+// inference of the same topology with 90% of every layer pruned, the layers
+// run on their sparse weights
+void benchmarkPruned(const Options &options, size_t layers, size_t neurons,
+                     size_t inputs, std::vector<Result> &results) {
+  NeuralNetwork::NeuralNetworkBuilder builder;
+  auto network = builder.setInputNeurons(inputs)
+                     .setOutputNeurons(options.outputs)
+                     .setIntermediateLayers(layers)
+                     .setIntermediateNeurons(neurons)
+                     .setActivation(Neuron::Activation::Logistic)
+                     .build();
+  NeuralNetwork::Pruning pruning;
+  pruning.sparsity = 0.9;
+  network->prune(pruning);
+  std::vector<std::vector<double>> input;
+  std::vector<std::vector<double>> output;
+  generate(options.samples, inputs, options.outputs, input, output);
+  const double layer_count = static_cast<double>(network->layerCount());
+
+  std::vector<double> result(options.outputs);
+  size_t sample = 0;
+  auto simulate = measure(
+      [&]() {
+        network->simulate(input[sample].data(), result.data());
+        sample = (sample + 1) % input.size();
+      },
+      options.min_seconds);
+  results.push_back({"simulatePruned", layers, neurons, inputs, 1, 1,
+                     1.0 / simulate.first, simulate.first * 1e9 / layer_count,
+                     simulate.second});
+
+  NeuralNetwork::Matrix batch(options.batch, inputs);
+  NeuralNetwork::Matrix predictions;
+  for (size_t b = 0; b < options.batch; ++b) {
+    std::copy(input[b % input.size()].begin(), input[b % input.size()].end(),
+              batch.row(b));
+  }
+  auto predict = measure([&]() { network->predictBatch(batch, predictions); },
+                         options.min_seconds);
+  results.push_back({"predictPruned", layers, neurons, inputs, 1,
+                     options.batch, options.batch / predict.first,
+                     predict.first * 1e9 / layer_count / options.batch,
+                     predict.second});
+}
+
+void benchmarkNeuron(const Options &options, size_t inputs,
+                     std::vector<Result> &results) {
+  std::mt19937 engine(7);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  std::vector<double> values(inputs);
+  std::vector<double> weights(inputs);
+  for (auto &value : values) value = uniform(engine);
+  for (auto &weight : weights) weight = uniform(engine);
+  const int iterations = 100;
+  auto step = measure(
+      [&]() {
+        Neuron::trainNeuron(
+            weights, 1.0,
+            [&values](const auto &w) {
+              return Neuron::detaRule(
+                  values, w, 1.0,
+                  [](double in) { return Neuron::logistic(in); },
+                  [](double in) { return Neuron::logisticDerivative(in); },
+                  0.1);
+            },
+            [&values](const auto &w) {
+              return Neuron::neuron(values, w, [](double in) {
+                return Neuron::logistic(in);
+              });
+            },
+            0.0, iterations, [](double) {});
+      },
+      options.min_seconds);
+  results.push_back({"trainNeuron", 0, 1, inputs, 1, 1,
+                     iterations / step.first, step.first * 1e9 / iterations,
+                     step.second / iterations});
+}
+
+// the same training as benchmarkNeuron for a family of independent neurons,
+// rates are neuron iterations per second
+void benchmarkPerceptronBatch(const Options &options, size_t inputs,
+                              std::vector<Result> &results) {
+  const size_t neurons = 4096;
+  const size_t iterations = 100;
+  std::mt19937 engine(7);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  std::vector<double> values(inputs);
+  std::vector<double> weights(inputs);
+  for (size_t threads : options.threads) {
+    NeuralNetwork::PerceptronBatch batch(neurons, inputs, threads);
+    for (size_t n = 0; n < neurons; ++n) {
+      for (auto &value : values) value = uniform(engine);
+      for (auto &weight : weights) weight = uniform(engine);
+      batch.setNeuron(n, values.data(), weights.data(), 1.0, 0.1);
+    }
+    auto step = measure(
+        [&]() {
+          batch.train(Neuron::Activation::Logistic, {}, 0.0, iterations);
+        },
+        options.min_seconds);
+    const double updates = static_cast<double>(neurons * iterations);
+    results.push_back({"perceptronBatch", 0, neurons, inputs, threads,
+                       NeuralNetwork::PerceptronBatch::lanes,
+                       updates / step.first, step.first * 1e9 / updates,
+                       step.second / updates});
+  }
+}
+
+// the edge deployment topology 8-16-16-4, runtime against compile-time sized
+void benchmarkStatic(const Options &options, std::vector<Result> &results) {
+  NeuralNetwork::NeuralNetworkBuilder builder;
+  auto network = builder.setInputNeurons(8)
+                     .setOutputNeurons(4)
+                     .setIntermediateLayers(2)
+                     .setIntermediateNeurons(16)
+                     .setActivation(Neuron::Activation::Logistic)
+                     .build();
+  const NeuralNetwork::StaticNetwork<Neuron::Policy::Logistic, 8, 16, 16, 4>
+      fixed(*network);
+  std::vector<std::vector<double>> input;
+  std::vector<std::vector<double>> output;
+  generate(options.samples, 8, 4, input, output);
+
+  std::array<double, 4> result;
+  size_t sample = 0;
+  auto runtime = measure(
+      [&]() {
+        network->simulate(input[sample].data(), result.data());
+        sample = (sample + 1) % input.size();
+      },
+      options.min_seconds);
+  results.push_back({"simulate", 2, 16, 8, 1, 1, 1.0 / runtime.first,
+                     runtime.first * 1e9 / 3, runtime.second});
+  auto compiled = measure(
+      [&]() {
+        fixed.simulate(input[sample].data(), result.data());
+        sample = (sample + 1) % input.size();
+      },
+      options.min_seconds);
+  results.push_back({"staticNetwork", 2, 16, 8, 1, 1, 1.0 / compiled.first,
+                     compiled.first * 1e9 / 3, compiled.second});
+}
+
+void print(const Options &options, const std::vector<Result> &results) {
+  if (options.format == "json") {
+    std::printf("{\"instruction_set\": \"%s\", \"results\": [",
+                Neuron::Kernels::instructionSet());
+    for (size_t i = 0; i < results.size(); ++i) {
+      const Result &r = results[i];
+      std::printf(
+          "%s\n  {\"benchmark\": \"%s\", \"layers\": %zu, \"neurons\": %zu, "
+          "\"inputs\": %zu, \"threads\": %zu, \"batch\": %zu, "
+          "\"samples_per_second\": %.1f, \"ns_per_layer\": %.1f, "
+          "\"allocations_per_step\": %.3f}",
+          i ? "," : "", r.name.c_str(), r.layers, r.neurons, r.inputs,
+          r.threads, r.batch, r.samples_per_second, r.ns_per_layer,
+          r.allocations_per_step);
+    }
+    std::printf("\n]}\n");
+  } else if (options.format == "csv") {
+    std::printf(
+        "benchmark,layers,neurons,inputs,threads,batch,samples_per_second,"
+        "ns_per_layer,allocations_per_step\n");
+    for (const Result &r : results) {
+      std::printf("%s,%zu,%zu,%zu,%zu,%zu,%.1f,%.1f,%.3f\n", r.name.c_str(),
+                  r.layers, r.neurons, r.inputs, r.threads, r.batch,
+                  r.samples_per_second, r.ns_per_layer,
+                  r.allocations_per_step);
+    }
+  } else {
+    std::printf("kernels: %s\n", Neuron::Kernels::instructionSet());
+    std::printf("%-15s %6s %7s %6s %7s %5s %14s %12s %10s\n", "benchmark",
+                "layers", "neurons", "inputs", "threads", "batch",
+                "samples/s", "ns/layer", "allocs");
+    for (const Result &r : results) {
+      std::printf("%-15s %6zu %7zu %6zu %7zu %5zu %14.1f %12.1f %10.3f\n",
+                  r.name.c_str(), r.layers, r.neurons, r.inputs, r.threads,
+                  r.batch, r.samples_per_second, r.ns_per_layer,
+                  r.allocations_per_step);
+    }
+  }
+}
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  try {
+    if (!parseOptions(argc, argv, options)) {
+      std::fprintf(stderr,
+                   "usage: %s [--layers L,..] [--neurons N,..] [--inputs I,..]"
+                   " [--threads T,..] [--outputs O] [--samples S] [--batch B]"
+                   " [--epochs E] [--min-time SECONDS]"
+                   " [--format table|csv|json]%s\n",
+                   argv[0],
+                   NeuralNetwork::Profiling::available ? " [--trace FILE]"
+                                                       : "");
+      return 1;
+    }
+  } catch (const std::exception &) {
+    std::fprintf(stderr, "invalid numeric argument\n");
+    return 1;
+  }
+
+  NeuralNetwork::Profiling::setEnabled(!options.trace.empty());
+  std::vector<Result> results;
+  for (size_t layers : options.layers) {
+    for (size_t neurons : options.neurons) {
+      for (size_t inputs : options.inputs) {
+        benchmarkTopology(options, layers, neurons, inputs, results);
+        benchmarkPruned(options, layers, neurons, inputs, results);
+      }
+    }
+  }
+  for (size_t inputs : options.inputs) {
+    benchmarkNeuron(options, inputs, results);
+    benchmarkPerceptronBatch(options, inputs, results);
+  }
+  benchmarkStatic(options, results);
+  print(options, results);
+  if (!options.trace.empty()) {
+    std::fputs(NeuralNetwork::Profiling::summary().c_str(), stderr);
+    if (!NeuralNetwork::Profiling::writeChromeTrace(options.trace)) {
+      std::fprintf(stderr, "cannot write %s\n", options.trace.c_str());
+      return 1;
+    }
+  }
+  return 0;
+}
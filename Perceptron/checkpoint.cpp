@@ -0,0 +1,382 @@
+#include "checkpoint.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include "network.h"
+
+namespace {
+constexpr char magic[8] = {'N', 'N', 'C', 'H', 'E', 'C', 'K', '\0'};
+constexpr uint32_t byteOrder = 0x01020304;
+
+// The file is a sequence of fixed size values, strings and matrices, each
+// count written as a uint64_t ahead of its items.
+class Output {
+ public:
+  explicit Output(const std::string &path)
+      : out(path, std::ios::binary | std::ios::trunc) {}
+  bool good() const { return static_cast<bool>(out); }
+  bool finish() {
+    out.flush();
+    out.close();
+    return !out.fail();
+  }
+
+  template <typename T>
+  void value(const T &value) {
+    static_assert(std::is_trivially_copyable<T>::value, "raw values only");
+    out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+  void count(size_t count) { value(static_cast<uint64_t>(count)); }
+  void text(const std::string &text) {
+    count(text.size());
+    out.write(text.data(), static_cast<std::streamsize>(text.size()));
+  }
+  void matrix(const NeuralNetwork::Matrix &matrix) {
+    count(matrix.rows());
+    count(matrix.cols());
+    out.write(reinterpret_cast<const char *>(matrix.data()),
+              static_cast<std::streamsize>(matrix.size() * sizeof(double)));
+  }
+  void matrices(const std::vector<NeuralNetwork::Matrix> &matrices) {
+    count(matrices.size());
+    for (const auto &m : matrices) matrix(m);
+  }
+
+ private:
+  std::ofstream out;
+};
+
+class Input {
+ public:
+  explicit Input(const std::string &path)
+      : in(path, std::ios::binary | std::ios::ate), path(path) {
+    if (!in) throw std::runtime_error("cannot open checkpoint " + path);
+    remaining = static_cast<uint64_t>(in.tellg());
+    in.seekg(0);
+  }
+
+  std::runtime_error invalid(const char *reason) const {
+    return std::runtime_error("invalid checkpoint " + path + ": " + reason);
+  }
+  void read(void *target, size_t size) {
+    if (size > remaining ||
+        !in.read(static_cast<char *>(target),
+                 static_cast<std::streamsize>(size))) {
+      throw invalid("truncated");
+    }
+    remaining -= size;
+  }
+
+  template <typename T>
+  T value() {
+    T value;
+    read(&value, sizeof(T));
+    return value;
+  }
+  // a count of items taking at least item_bytes each, checked against the
+  // rest of the file before anything is allocated for them
+  size_t count(size_t item_bytes = 0) {
+    const auto count = value<uint64_t>();
+    if (item_bytes && count > remaining / item_bytes) throw invalid("bad size");
+    return static_cast<size_t>(count);
+  }
+  std::string text() {
+    std::string text(count(1), '\0');
+    read(&text[0], text.size());
+    return text;
+  }
+  NeuralNetwork::Matrix matrix() {
+    const size_t rows = count();
+    const size_t cols = count();
+    if (cols && rows > remaining / sizeof(double) / cols) {
+      throw invalid("bad size");
+    }
+    NeuralNetwork::Matrix matrix(rows, cols);
+    read(matrix.data(), matrix.size() * sizeof(double));
+    return matrix;
+  }
+  std::vector<NeuralNetwork::Matrix> matrices() {
+    // every matrix starts with its two sizes
+    std::vector<NeuralNetwork::Matrix> matrices(count(2 * sizeof(uint64_t)));
+    for (auto &m : matrices) m = matrix();
+    return matrices;
+  }
+
+ private:
+  std::ifstream in;
+  std::string path;
+  uint64_t remaining{0};
+};
+
+void writeOptimizer(Output &out, const NeuralNetwork::Optimizer &optimizer) {
+  out.value(static_cast<uint32_t>(optimizer.method));
+  out.value(optimizer.momentum);
+  out.value(optimizer.beta1);
+  out.value(optimizer.beta2);
+  out.value(optimizer.epsilon);
+  out.value(static_cast<uint32_t>(optimizer.schedule.kind));
+  out.value(optimizer.schedule.factor);
+  out.count(optimizer.schedule.step_epochs);
+  out.value(optimizer.schedule.minimum);
+}
+
+NeuralNetwork::Optimizer readOptimizer(Input &in) {
+  using Method = NeuralNetwork::Optimizer::Method;
+  using Kind = NeuralNetwork::LearningRateSchedule::Kind;
+  NeuralNetwork::Optimizer optimizer;
+  const auto method = in.value<uint32_t>();
+  if (method > static_cast<uint32_t>(Method::Adam)) {
+    throw in.invalid("unknown optimizer");
+  }
+  optimizer.method = static_cast<Method>(method);
+  optimizer.momentum = in.value<double>();
+  optimizer.beta1 = in.value<double>();
+  optimizer.beta2 = in.value<double>();
+  optimizer.epsilon = in.value<double>();
+  const auto kind = in.value<uint32_t>();
+  if (kind > static_cast<uint32_t>(Kind::Cosine)) {
+    throw in.invalid("unknown schedule");
+  }
+  optimizer.schedule.kind = static_cast<Kind>(kind);
+  optimizer.schedule.factor = in.value<double>();
+  optimizer.schedule.step_epochs = in.count();
+  optimizer.schedule.minimum = in.value<double>();
+  return optimizer;
+}
+}  // namespace
+
+void NeuralNetwork::Checkpoint::save(const TrainingState &state,
+                                     const std::string &path) {
+  if (state.activation == Neuron::Activation::Custom) {
+    throw std::runtime_error(
+        "networks with a custom activation cannot be checkpointed");
+  }
+  const std::string temporary = path + ".tmp";
+  {
+    Output out(temporary);
+    if (!out.good()) {
+      throw std::runtime_error("cannot create checkpoint " + temporary);
+    }
+    out.value(magic);
+    out.value(uint32_t{version});
+    out.value(byteOrder);
+    out.count(state.epoch);
+    out.count(state.epochs);
+    out.value(static_cast<uint32_t>(state.activation));
+    out.value(state.parameters.beta);
+    out.value(state.parameters.theta);
+    writeOptimizer(out, state.optimizer);
+    out.count(state.optimizer_steps);
+    out.matrices(state.weights);
+    out.matrices(state.first_moments);
+    out.matrices(state.second_moments);
+    out.matrices(state.masks);
+    out.value(state.best_loss);
+    out.count(state.stale_epochs);
+    out.matrices(state.best_weights);
+    out.count(state.sample_order.size());
+    for (size_t index : state.sample_order) out.count(index);
+    out.text(state.sample_engine);
+    out.text(state.description);
+    if (!out.finish()) {
+      std::remove(temporary.c_str());
+      throw std::runtime_error("cannot write checkpoint " + temporary);
+    }
+  }
+  // rename() replaces the target atomically on POSIX, elsewhere it has to
+  // be removed first
+  if (std::rename(temporary.c_str(), path.c_str()) != 0 &&
+      (std::remove(path.c_str()) != 0 ||
+       std::rename(temporary.c_str(), path.c_str()) != 0)) {
+    throw std::runtime_error("cannot replace checkpoint " + path);
+  }
+}
+
+NeuralNetwork::TrainingState NeuralNetwork::Checkpoint::load(
+    const std::string &path) {
+  Input in(path);
+  char file_magic[sizeof(magic)];
+  in.read(file_magic, sizeof(file_magic));
+  if (std::memcmp(file_magic, magic, sizeof(magic)) != 0) {
+    throw in.invalid("bad magic");
+  }
+  if (in.value<uint32_t>() != version) throw in.invalid("unsupported version");
+  if (in.value<uint32_t>() != byteOrder) throw in.invalid("foreign byte order");
+
+  TrainingState state;
+  state.epoch = in.count();
+  state.epochs = in.count();
+  const auto activation = in.value<uint32_t>();
+  if (activation >= static_cast<uint32_t>(Neuron::Activation::Custom)) {
+    throw in.invalid("unknown activation");
+  }
+  state.activation = static_cast<Neuron::Activation>(activation);
+  state.parameters.beta = in.value<double>();
+  state.parameters.theta = in.value<double>();
+  state.optimizer = readOptimizer(in);
+  state.optimizer_steps = in.count();
+  state.weights = in.matrices();
+  state.first_moments = in.matrices();
+  state.second_moments = in.matrices();
+  state.masks = in.matrices();
+  state.best_loss = in.value<double>();
+  state.stale_epochs = in.count();
+  state.best_weights = in.matrices();
+  state.sample_order.resize(in.count(sizeof(uint64_t)));
+  for (auto &index : state.sample_order) index = in.count();
+  state.sample_engine = in.text();
+  state.description = in.text();
+
+  const size_t layers = state.weights.size();
+  if (!layers) throw in.invalid("no layers");
+  for (size_t l = 0; l < layers; ++l) {
+    const Matrix &weights = state.weights[l];
+    if (!weights.size()) throw in.invalid("empty layer");
+    if (l && weights.cols() != state.weights[l - 1].rows()) {
+      throw in.invalid("layer sizes do not chain");
+    }
+  }
+  auto shaped = [&state, layers](const std::vector<Matrix> &matrices) {
+    if (matrices.empty()) return true;
+    if (matrices.size() != layers) return false;
+    for (size_t l = 0; l < layers; ++l) {
+      if (matrices[l].rows() != state.weights[l].rows() ||
+          matrices[l].cols() != state.weights[l].cols()) {
+        return false;
+      }
+    }
+    return true;
+  };
+  const size_t states = state.optimizer.stateCount();
+  if (!shaped(state.first_moments) || !shaped(state.second_moments) ||
+      !shaped(state.masks) || !shaped(state.best_weights) ||
+      state.first_moments.empty() != (states < 1) ||
+      state.second_moments.empty() != (states < 2)) {
+    throw in.invalid("state does not match the layers");
+  }
+  return state;
+}
+
+std::unique_ptr<NeuralNetwork::NeuralNetwork>
+NeuralNetwork::Checkpoint::resume(TrainingState state) {
+  auto network = std::make_unique<NeuralNetwork>();
+  const size_t layers = state.weights.size();
+  network->layers.resize(layers);
+  for (size_t l = 0; l < layers; ++l) {
+    auto &layer = network->layers[l];
+    layer.neurons.assign(state.weights[l].rows(), 0);
+    layer.sums.assign(state.weights[l].rows(), 0);
+    layer.weights = std::move(state.weights[l]);
+    if (!state.first_moments.empty()) {
+      layer.first_moment = std::move(state.first_moments[l]);
+    }
+    if (!state.second_moments.empty()) {
+      layer.second_moment = std::move(state.second_moments[l]);
+    }
+    if (!state.masks.empty()) layer.mask = std::move(state.masks[l]);
+  }
+  network->activation = state.activation;
+  network->parameters = state.parameters;
+  network->optimizer = state.optimizer;
+  network->optimizer_steps = state.optimizer_steps;
+  state.weights.clear();
+  state.first_moments.clear();
+  state.second_moments.clear();
+  state.masks.clear();
+  network->resumed = std::make_unique<TrainingState>(std::move(state));
+  return network;
+}
+
+std::unique_ptr<NeuralNetwork::NeuralNetwork>
+NeuralNetwork::Checkpoint::resume(const std::string &path) {
+  return resume(load(path));
+}
+
+NeuralNetwork::CheckpointWriter::CheckpointWriter(
+    std::string path, size_t interval, std::chrono::milliseconds spacing)
+    : file_path(std::move(path)),
+      interval(std::max<size_t>(interval, 1)),
+      spacing(spacing),
+      last_submit(std::chrono::steady_clock::now() - spacing),
+      thread(&CheckpointWriter::run, this) {}
+
+NeuralNetwork::CheckpointWriter::~CheckpointWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  thread.join();
+}
+
+void NeuralNetwork::CheckpointWriter::setDescription(std::string description) {
+  std::lock_guard<std::mutex> lock(mutex);
+  this->description = std::move(description);
+}
+
+// Taking the spare state withdraws it if it was submitted and not picked up
+// yet, the training then overwrites it with a newer one.
+NeuralNetwork::TrainingState *NeuralNetwork::CheckpointWriter::acquire(
+    size_t epoch) {
+  if (epoch % interval) return nullptr;
+  const auto now = std::chrono::steady_clock::now();
+  if (now - last_submit < spacing) return nullptr;
+  std::lock_guard<std::mutex> lock(mutex);
+  queued = false;
+  return &states[spare];
+}
+
+void NeuralNetwork::CheckpointWriter::submit() {
+  last_submit = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    states[spare].description = description;
+    queued = true;
+  }
+  wake.notify_one();
+}
+
+void NeuralNetwork::CheckpointWriter::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [this] { return !queued && !busy; });
+}
+
+size_t NeuralNetwork::CheckpointWriter::written() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return written_count;
+}
+
+std::string NeuralNetwork::CheckpointWriter::error() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return last_error;
+}
+
+void NeuralNetwork::CheckpointWriter::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    wake.wait(lock, [this] { return queued || stopping; });
+    if (!queued) return;
+    const TrainingState &state = states[spare];
+    spare = 1 - spare;
+    queued = false;
+    busy = true;
+    lock.unlock();
+    std::string failure;
+    try {
+      Checkpoint::save(state, file_path);
+    } catch (const std::exception &e) {
+      failure = e.what();
+    }
+    lock.lock();
+    busy = false;
+    if (failure.empty()) {
+      ++written_count;
+    } else {
+      last_error = failure;
+    }
+    done.notify_all();
+  }
+}
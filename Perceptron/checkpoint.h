@@ -0,0 +1,115 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "activation.h"
+#include "matrix.h"
+#include "optimizer.h"
+namespace NeuralNetwork {
+class NeuralNetwork;
+
+// Everything a training needs to go on where it stopped, taken after a
+// finished epoch.
+struct TrainingState {
+  // epochs finished, a resumed training starts with this one
+  size_t epoch{0};
+  // epochs the training was started for
+  size_t epochs{0};
+  Neuron::Activation activation{Neuron::Activation::Logistic};
+  Neuron::ActivationParameters parameters;
+  Optimizer optimizer;
+  size_t optimizer_steps{0};
+  // per layer, the moments are empty when the optimizer has no state
+  std::vector<Matrix> weights;
+  std::vector<Matrix> first_moments;
+  std::vector<Matrix> second_moments;
+  // per layer, empty unless the network was pruned
+  std::vector<Matrix> masks;
+  // early stopping, best_weights is empty unless it keeps the best epoch
+  double best_loss{std::numeric_limits<double>::infinity()};
+  size_t stale_epochs{0};
+  std::vector<Matrix> best_weights;
+  // order and shuffle engine of a trained SampleView, empty for other
+  // samples
+  std::vector<size_t> sample_order;
+  std::string sample_engine;
+  // left to the caller, e.g. where the samples came from
+  std::string description;
+};
+
+// Binary checkpoint files in native byte order, rejected on a foreign one
+// like model files. save() writes a temporary file next to path and renames
+// it over path, so a preempted run leaves either the old or the new
+// checkpoint. Errors are reported as std::runtime_error.
+class Checkpoint {
+ public:
+  static constexpr uint32_t version = 2;
+
+  static void save(const TrainingState &state, const std::string &path);
+  static TrainingState load(const std::string &path);
+  // network in the state of the checkpoint, its next train() continues
+  // with the epoch after it and puts back the order of a SampleView
+  static std::unique_ptr<NeuralNetwork> resume(TrainingState state);
+  static std::unique_ptr<NeuralNetwork> resume(const std::string &path);
+};
+
+// Writes the checkpoints of a training on its own thread. The training
+// fills the spare one of two states and submits it, the thread writes it
+// while the training goes on and fills the other one. A state submitted
+// while the thread is still busy waits and is replaced by a newer one, so
+// the training never waits for the disk and the newest state gets written.
+//
+// A checkpoint is due every interval epochs, at most once per spacing.
+class CheckpointWriter {
+ public:
+  explicit CheckpointWriter(
+      std::string path, size_t interval = 1,
+      std::chrono::milliseconds spacing = std::chrono::milliseconds(0));
+  // writes the submitted state before returning
+  ~CheckpointWriter();
+  CheckpointWriter(const CheckpointWriter &) = delete;
+  CheckpointWriter &operator=(const CheckpointWriter &) = delete;
+
+  const std::string &path() const { return file_path; }
+  // stored with every following checkpoint
+  void setDescription(std::string description);
+  // the spare state when a checkpoint is due after epoch, nullptr otherwise
+  TrainingState *acquire(size_t epoch);
+  // hands the state from acquire() to the thread
+  void submit();
+  // blocks until the submitted state is on disk
+  void wait();
+  size_t written() const;
+  // message of the last failed write, empty if there was none
+  std::string error() const;
+
+ private:
+  void run();
+
+  std::string file_path;
+  size_t interval;
+  std::chrono::milliseconds spacing;
+  std::chrono::steady_clock::time_point last_submit;
+  std::string description;
+  TrainingState states[2];
+  // the state the training fills, the thread writes the other one
+  size_t spare{0};
+  bool queued{false};
+  bool busy{false};
+  bool stopping{false};
+  size_t written_count{0};
+  std::string last_error;
+  mutable std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  std::thread thread;
+};
+}  // namespace NeuralNetwork
+#endif  // CHECKPOINT_H
@@ -0,0 +1,165 @@
+#include "compactnetwork.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "kernels.h"
+
+namespace {
+constexpr float int8Limit = 127.0f;
+}  // namespace
+
+template <>
+void NeuralNetwork::CompactNetwork<float>::store(const Matrix &source,
+                                                 Layer &layer) {
+  layer.weights.assign(source.begin(), source.end());
+}
+
+template <>
+void NeuralNetwork::CompactNetwork<int8_t>::store(const Matrix &source,
+                                                  Layer &layer) {
+  double largest = 0.0;
+  for (double weight : source) largest = std::max(largest, std::abs(weight));
+  layer.scale = largest > 0.0 ? static_cast<float>(largest) / int8Limit : 1.0f;
+  const double inverse = 1.0 / layer.scale;
+  layer.weights.resize(source.size());
+  std::transform(source.begin(), source.end(), layer.weights.begin(),
+                 [inverse](double weight) {
+                   return static_cast<int8_t>(std::lround(weight * inverse));
+                 });
+}
+
+template <>
+void NeuralNetwork::CompactNetwork<float>::sums(const Layer &layer,
+                                                const float *input,
+                                                float *output, bool) const {
+  for (size_t i = 0; i < layer.rows; ++i) {
+    output[i] = Neuron::Kernels::dot(input, layer.weights.data() + i * layer.cols,
+                                     layer.cols);
+  }
+}
+
+template <>
+void NeuralNetwork::CompactNetwork<int8_t>::sums(const Layer &layer,
+                                                 const float *input,
+                                                 float *output,
+                                                 bool network_input) const {
+  thread_local std::vector<int8_t> quantized;
+  float input_scale = 1.0f / int8Limit;
+  if (network_input) {
+    float largest = 0.0f;
+    for (size_t k = 0; k < layer.cols; ++k) {
+      largest = std::max(largest, std::abs(input[k]));
+    }
+    if (largest > 0.0f) input_scale = largest / int8Limit;
+  }
+  const float inverse = 1.0f / input_scale;
+  quantized.resize(layer.cols);
+  for (size_t k = 0; k < layer.cols; ++k) {
+    const float value = std::min(std::max(input[k] * inverse, -int8Limit),
+                                 int8Limit);
+    quantized[k] = static_cast<int8_t>(std::lround(value));
+  }
+  const float factor = input_scale * layer.scale;
+  for (size_t i = 0; i < layer.rows; ++i) {
+    output[i] = factor * static_cast<float>(Neuron::Kernels::dot(
+                             quantized.data(),
+                             layer.weights.data() + i * layer.cols,
+                             layer.cols));
+  }
+}
+
+template <typename Weight>
+NeuralNetwork::CompactNetwork<Weight>::CompactNetwork(
+    const NeuralNetwork &network)
+    : activation(network.activationFunction()),
+      beta(static_cast<float>(network.activationParameters().beta)),
+      theta(static_cast<float>(network.activationParameters().theta)) {
+  if (activation == Neuron::Activation::Custom) {
+    throw std::invalid_argument(
+        "compact networks support the built in activations only");
+  }
+  layers.resize(network.layerCount());
+  for (size_t l = 0; l < layers.size(); ++l) {
+    const Matrix &weights = network.layerWeights(l);
+    layers[l].rows = weights.rows();
+    layers[l].cols = weights.cols();
+    store(weights, layers[l]);
+  }
+}
+
+template <typename Weight>
+void NeuralNetwork::CompactNetwork<Weight>::activate(float *values,
+                                                     size_t size) const {
+  switch (activation) {
+    case Neuron::Activation::Heaviside: {
+      const float threshold = theta;
+      std::transform(values, values + size, values, [threshold](float value) {
+        return value >= threshold ? 1.0f : 0.0f;
+      });
+      break;
+    }
+    case Neuron::Activation::Sign: {
+      const float threshold = theta;
+      std::transform(values, values + size, values, [threshold](float value) {
+        return static_cast<float>((value > threshold) - (value < threshold));
+      });
+      break;
+    }
+    case Neuron::Activation::Logistic:
+      Neuron::Kernels::logistic(values, values, size, beta, theta);
+      break;
+    case Neuron::Activation::Tanh:
+      Neuron::Kernels::hypertan(values, values, size, theta);
+      break;
+    case Neuron::Activation::Custom:
+      break;
+  }
+}
+
+template <typename Weight>
+void NeuralNetwork::CompactNetwork<Weight>::simulate(const float *input,
+                                                     float *output) const {
+  // ping-pong buffers for the hidden layers, grown once per thread
+  thread_local std::vector<float> scratch[2];
+  const float *current = input;
+  for (size_t l = 0; l < layers.size(); ++l) {
+    float *target = output;
+    if (l + 1 != layers.size()) {
+      scratch[l % 2].resize(layers[l].rows);
+      target = scratch[l % 2].data();
+    }
+    sums(layers[l], current, target, l == 0);
+    activate(target, layers[l].rows);
+    current = target;
+  }
+}
+
+template <typename Weight>
+std::vector<float> NeuralNetwork::CompactNetwork<Weight>::simulate(
+    const std::vector<float> &input) const {
+  std::vector<float> output(outputCount());
+  simulate(input.data(), output.data());
+  return output;
+}
+
+template <typename Weight>
+size_t NeuralNetwork::CompactNetwork<Weight>::inputCount() const {
+  return layers.empty() ? 0 : layers.front().cols;
+}
+
+template <typename Weight>
+size_t NeuralNetwork::CompactNetwork<Weight>::outputCount() const {
+  return layers.empty() ? 0 : layers.back().rows;
+}
+
+template <typename Weight>
+size_t NeuralNetwork::CompactNetwork<Weight>::weightBytes() const {
+  size_t bytes = 0;
+  for (const auto &layer : layers) bytes += layer.weights.size() * sizeof(Weight);
+  return bytes;
+}
+
+template class NeuralNetwork::CompactNetwork<float>;
+template class NeuralNetwork::CompactNetwork<int8_t>;
@@ -0,0 +1,54 @@
+#ifndef COMPACTNETWORK_H
+#define COMPACTNETWORK_H
+#include <cstdint>
+#include <vector>
+#include "activation.h"
+#include "matrix.h"
+#include "network.h"
+namespace NeuralNetwork {
+// Inference-only copy of a trained network with smaller weights.
+// CompactNetwork<float> keeps single precision weights and math,
+// CompactNetwork<int8_t> quantizes every layer symmetrically to int8 with a
+// per-layer scale and accumulates in int32. Inputs and outputs are float in
+// both cases. The network input is quantized with a per-sample scale, the
+// hidden activations of the built in functions lie in [-1, 1] and use a
+// fixed one, which is why custom activations are rejected with
+// std::invalid_argument. simulate() is const and keeps its scratch buffers
+// per thread, so one instance can serve many threads. Only the float and
+// int8_t instantiations exist.
+template <typename Weight>
+class CompactNetwork {
+ public:
+  explicit CompactNetwork(const NeuralNetwork &network);
+
+  void simulate(const float *input, float *output) const;
+  std::vector<float> simulate(const std::vector<float> &input) const;
+  size_t inputCount() const;
+  size_t outputCount() const;
+  // memory taken by the weights of all layers
+  size_t weightBytes() const;
+
+ private:
+  struct Layer {
+    size_t rows{0};
+    size_t cols{0};
+    // real weight = scale * stored weight
+    float scale{1.0f};
+    std::vector<Weight, AlignedAllocator<Weight>> weights;
+  };
+
+  static void store(const Matrix &source, Layer &layer);
+  void sums(const Layer &layer, const float *input, float *output,
+            bool network_input) const;
+  void activate(float *values, size_t size) const;
+
+  std::vector<Layer> layers;
+  Neuron::Activation activation;
+  float beta;
+  float theta;
+};
+
+using FloatNetwork = CompactNetwork<float>;
+using QuantizedNetwork = CompactNetwork<int8_t>;
+}  // namespace NeuralNetwork
+#endif  // COMPACTNETWORK_H
@@ -0,0 +1,52 @@
+# Network core without any Qt dependency, included by the GUI application
+# and the headless benchmark.
+
+INCLUDEPATH += $$PWD
+
+CONFIG += thread
+
+# CONFIG += profiling times the hot paths per layer, see profiler.h
+profiling: DEFINES += NEURALNETWORK_PROFILING
+
+SOURCES += \
+    $$PWD/network.cpp \
+    $$PWD/matrix.cpp \
+    $$PWD/kernels.cpp \
+    $$PWD/threadpool.cpp \
+    $$PWD/modelfile.cpp \
+    $$PWD/compactnetwork.cpp \
+    $$PWD/dataset.cpp \
+    $$PWD/batchstream.cpp \
+    $$PWD/samples.cpp \
+    $$PWD/evaluation.cpp \
+    $$PWD/generator.cpp \
+    $$PWD/optimizer.cpp \
+    $$PWD/sweep.cpp \
+    $$PWD/profiler.cpp \
+    $$PWD/perceptronbatch.cpp \
+    $$PWD/decimator.cpp \
+    $$PWD/checkpoint.cpp \
+    $$PWD/sparsematrix.cpp
+
+HEADERS += \
+    $$PWD/neuron.h \
+    $$PWD/network.h \
+    $$PWD/matrix.h \
+    $$PWD/kernels.h \
+    $$PWD/activation.h \
+    $$PWD/threadpool.h \
+    $$PWD/modelfile.h \
+    $$PWD/compactnetwork.h \
+    $$PWD/dataset.h \
+    $$PWD/batchstream.h \
+    $$PWD/samples.h \
+    $$PWD/evaluation.h \
+    $$PWD/generator.h \
+    $$PWD/optimizer.h \
+    $$PWD/staticnetwork.h \
+    $$PWD/sweep.h \
+    $$PWD/profiler.h \
+    $$PWD/perceptronbatch.h \
+    $$PWD/decimator.h \
+    $$PWD/checkpoint.h \
+    $$PWD/sparsematrix.h
@@ -0,0 +1,393 @@
+#include "dataset.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define DATASET_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr char magic[8] = {'N', 'N', 'D', 'A', 'T', 'A', '\0', '\0'};
+constexpr uint32_t byteOrder = 0x01020304;
+constexpr uint64_t blockAlignment = 64;
+constexpr size_t checkpointInterval = 1024;
+constexpr size_t csvBufferSize = size_t{1} << 20;
+constexpr size_t writeChunkRows = 4096;
+
+struct ColumnarHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t input_count;
+  uint64_t output_count;
+  uint64_t rows;
+  uint64_t reserved[3];
+};
+static_assert(sizeof(ColumnarHeader) == 64,
+              "dataset header must stay 64 bytes");
+
+uint64_t alignBlock(uint64_t offset) {
+  return (offset + blockAlignment - 1) / blockAlignment * blockAlignment;
+}
+
+// 64 bit offsets on every platform, the datasets easily exceed 2 GB
+bool seekFile(std::FILE *file, uint64_t offset) {
+#ifdef _WIN32
+  return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+  return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+#ifndef DATASET_MMAP
+uint64_t fileSize(std::FILE *file) {
+#ifdef _WIN32
+  _fseeki64(file, 0, SEEK_END);
+  return static_cast<uint64_t>(_ftelli64(file));
+#else
+  fseeko(file, 0, SEEK_END);
+  return static_cast<uint64_t>(ftello(file));
+#endif
+}
+#endif
+
+bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+bool isSeparator(char c) { return isBlank(c) || c == ',' || c == ';'; }
+
+// data lines start with a number, anything else is a header or comment
+bool isSample(const char *line, const char *line_end) {
+  while (line != line_end && isBlank(*line)) ++line;
+  return line != line_end &&
+         (std::isdigit(static_cast<unsigned char>(*line)) || *line == '-' ||
+          *line == '+' || *line == '.');
+}
+
+// Decimal number parser independent of the C locale, which the GUI sets to
+// the user's one where the decimal separator may be a comma. Advances text
+// past the number, false if there is none.
+bool parseNumber(const char *&text, const char *end, double &value) {
+  const char *p = text;
+  bool negative = false;
+  if (p != end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  int digits = 0;
+  bool any = false;
+  for (; p != end && std::isdigit(static_cast<unsigned char>(*p)); ++p) {
+    any = true;
+    if (digits < 19) {
+      mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+      if (mantissa) ++digits;
+    } else {
+      ++exponent;
+    }
+  }
+  if (p != end && *p == '.') {
+    for (++p; p != end && std::isdigit(static_cast<unsigned char>(*p)); ++p) {
+      any = true;
+      if (digits < 19) {
+        mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+        if (mantissa) ++digits;
+        --exponent;
+      }
+    }
+  }
+  if (!any) return false;
+  if (p != end && (*p == 'e' || *p == 'E')) {
+    const char *e = p + 1;
+    bool negative_exponent = false;
+    if (e != end && (*e == '-' || *e == '+')) negative_exponent = (*e++ == '-');
+    if (e != end && std::isdigit(static_cast<unsigned char>(*e))) {
+      int written = 0;
+      for (; e != end && std::isdigit(static_cast<unsigned char>(*e)); ++e) {
+        if (written < 10000) written = written * 10 + (*e - '0');
+      }
+      exponent += negative_exponent ? -written : written;
+      p = e;
+    }
+  }
+  long double result = static_cast<long double>(mantissa);
+  if (exponent) result *= std::pow(10.0L, exponent);
+  value = static_cast<double>(negative ? -result : result);
+  text = p;
+  return true;
+}
+}  // namespace
+
+NeuralNetwork::CsvReader::CsvReader(const std::string &path,
+                                    size_t input_count, size_t output_count)
+    : path(path),
+      file(std::fopen(path.c_str(), "rb"), std::fclose),
+      input_count(input_count),
+      output_count(output_count),
+      buffer(csvBufferSize + 1) {
+  if (!file) throw std::runtime_error("cannot open dataset " + path);
+  rewindTo(0);
+  const char *line;
+  const char *line_end;
+  while (nextLine(line, line_end)) {
+    if (!isSample(line, line_end)) continue;
+    if (row_count % checkpointInterval == 0) {
+      checkpoints.push_back(buffer_offset +
+                            static_cast<uint64_t>(line - buffer.data()));
+    }
+    ++row_count;
+  }
+  rewindTo(0);
+}
+
+void NeuralNetwork::CsvReader::rewindTo(uint64_t offset) {
+  if (!seekFile(file.get(), offset)) {
+    throw std::runtime_error("cannot seek in dataset " + path);
+  }
+  buffer_begin = 0;
+  buffer_end = 0;
+  buffer_offset = offset;
+  buffer[0] = '\0';
+  eof = false;
+}
+
+// Hands out the next line without its terminator. The line stays valid
+// until the following call, the buffer only grows for lines longer than it.
+bool NeuralNetwork::CsvReader::nextLine(const char *&line,
+                                        const char *&line_end) {
+  for (;;) {
+    const char *begin = buffer.data() + buffer_begin;
+    const char *end = buffer.data() + buffer_end;
+    const char *newline = static_cast<const char *>(
+        std::memchr(begin, '\n', static_cast<size_t>(end - begin)));
+    if (newline || (eof && begin != end)) {
+      line = begin;
+      line_end = newline ? newline : end;
+      buffer_begin = static_cast<size_t>((newline ? newline + 1 : end) -
+                                         buffer.data());
+      return true;
+    }
+    if (eof) return false;
+    const size_t rest = buffer_end - buffer_begin;
+    std::memmove(buffer.data(), begin, rest);
+    buffer_offset += buffer_begin;
+    buffer_begin = 0;
+    buffer_end = rest;
+    if (rest == buffer.size() - 1) buffer.resize(2 * buffer.size() - 1);
+    const size_t got = std::fread(buffer.data() + rest, 1,
+                                  buffer.size() - 1 - rest, file.get());
+    if (!got && std::ferror(file.get())) {
+      throw std::runtime_error("cannot read dataset " + path);
+    }
+    buffer_end += got;
+    buffer[buffer_end] = '\0';
+    eof = !got;
+  }
+}
+
+void NeuralNetwork::CsvReader::seek(size_t row) {
+  position = std::min(row, row_count);
+  if (position == row_count) return;
+  rewindTo(checkpoints[position / checkpointInterval]);
+  const char *line;
+  const char *line_end;
+  for (size_t skip = position % checkpointInterval; skip;) {
+    nextLine(line, line_end);
+    if (isSample(line, line_end)) --skip;
+  }
+}
+
+size_t NeuralNetwork::CsvReader::read(size_t count, Matrix &inputs,
+                                      Matrix &outputs) {
+  const size_t rows = std::min(count, row_count - position);
+  inputs.resize(rows, input_count);
+  outputs.resize(rows, output_count);
+  const char *line;
+  const char *line_end;
+  for (size_t r = 0; r < rows; ++r) {
+    do {
+      if (!nextLine(line, line_end)) {
+        throw std::runtime_error("dataset " + path + " changed while reading");
+      }
+    } while (!isSample(line, line_end));
+    auto parse = [&](double *values, size_t value_count) {
+      for (size_t i = 0; i < value_count; ++i) {
+        while (line != line_end && isSeparator(*line)) ++line;
+        if (!parseNumber(line, line_end, values[i])) {
+          throw std::runtime_error("malformed sample " +
+                                   std::to_string(position + r + 1) +
+                                   " in dataset " + path);
+        }
+      }
+    };
+    parse(inputs.row(r), input_count);
+    parse(outputs.row(r), output_count);
+  }
+  position += rows;
+  return rows;
+}
+
+NeuralNetwork::ColumnarReader::ColumnarReader(const std::string &path)
+    : path(path) {
+  auto invalid = [&path](const char *reason) {
+    return std::runtime_error("invalid dataset " + path + ": " + reason);
+  };
+  ColumnarHeader header;
+  uint64_t size = 0;
+#ifdef DATASET_MMAP
+  int descriptor = ::open(path.c_str(), O_RDONLY);
+  if (descriptor < 0) throw std::runtime_error("cannot open dataset " + path);
+  struct stat info;
+  if (::fstat(descriptor, &info) != 0 || info.st_size <= 0) {
+    ::close(descriptor);
+    throw std::runtime_error("cannot read dataset " + path);
+  }
+  size = static_cast<uint64_t>(info.st_size);
+  void *address = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, descriptor, 0);
+  ::close(descriptor);
+  if (address == MAP_FAILED) {
+    throw std::runtime_error("cannot map dataset " + path);
+  }
+  // batches are read front to back, let the kernel read ahead
+  ::madvise(address, size, MADV_SEQUENTIAL);
+  mapping = std::shared_ptr<void>(
+      address, [size](void *mapped) { ::munmap(mapped, size); });
+  mapped = static_cast<const char *>(address);
+  if (size < sizeof(header)) throw invalid("truncated header");
+  std::memcpy(&header, mapped, sizeof(header));
+#else
+  file.reset(std::fopen(path.c_str(), "rb"));
+  if (!file) throw std::runtime_error("cannot open dataset " + path);
+  size = fileSize(file.get());
+  if (size < sizeof(header) || !seekFile(file.get(), 0) ||
+      std::fread(&header, sizeof(header), 1, file.get()) != 1) {
+    throw invalid("truncated header");
+  }
+#endif
+  if (std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+    throw invalid("bad magic");
+  }
+  if (header.byte_order != byteOrder) throw invalid("foreign byte order");
+  if (header.version != version) throw invalid("unsupported version");
+  const uint64_t columns = header.input_count + header.output_count;
+  if (!header.input_count || !header.output_count ||
+      columns < header.input_count ||
+      header.rows > size / sizeof(double)) {
+    throw invalid("bad dimensions");
+  }
+  column_stride = alignBlock(header.rows * sizeof(double));
+  if (column_stride && columns > (size - sizeof(header)) / column_stride) {
+    throw invalid("truncated columns");
+  }
+  input_count = header.input_count;
+  output_count = header.output_count;
+  row_count = header.rows;
+}
+
+void NeuralNetwork::ColumnarReader::seek(size_t row) {
+  position = std::min(row, row_count);
+}
+
+// count values of the column starting at sample first, straight from the
+// mapping or read into the scratch buffer
+const double *NeuralNetwork::ColumnarReader::column(size_t index,
+                                                    size_t first,
+                                                    size_t count) {
+  const uint64_t offset = sizeof(ColumnarHeader) + index * column_stride +
+                          first * sizeof(double);
+  if (mapped) return reinterpret_cast<const double *>(mapped + offset);
+  scratch.resize(count);
+  if (!seekFile(file.get(), offset) ||
+      std::fread(scratch.data(), sizeof(double), count, file.get()) != count) {
+    throw std::runtime_error("cannot read dataset " + path);
+  }
+  return scratch.data();
+}
+
+size_t NeuralNetwork::ColumnarReader::read(size_t count, Matrix &inputs,
+                                           Matrix &outputs) {
+  const size_t rows = std::min(count, row_count - position);
+  inputs.resize(rows, input_count);
+  outputs.resize(rows, output_count);
+  // gathers the columns into row-major batches
+  for (size_t c = 0; c < input_count; ++c) {
+    const double *values = column(c, position, rows);
+    for (size_t r = 0; r < rows; ++r) inputs(r, c) = values[r];
+  }
+  for (size_t c = 0; c < output_count; ++c) {
+    const double *values = column(input_count + c, position, rows);
+    for (size_t r = 0; r < rows; ++r) outputs(r, c) = values[r];
+  }
+  position += rows;
+  return rows;
+}
+
+void NeuralNetwork::ColumnarReader::write(DatasetReader &source,
+                                          const std::string &path) {
+  ColumnarHeader header{};
+  std::memcpy(header.magic, magic, sizeof(magic));
+  header.version = version;
+  header.byte_order = byteOrder;
+  header.input_count = source.inputCount();
+  header.output_count = source.outputCount();
+  header.rows = source.rows();
+  const uint64_t stride = alignBlock(header.rows * sizeof(double));
+  const uint64_t columns = header.input_count + header.output_count;
+
+  std::unique_ptr<std::FILE, int (*)(std::FILE *)> out(
+      std::fopen(path.c_str(), "wb"), std::fclose);
+  if (!out) throw std::runtime_error("cannot create dataset " + path);
+  auto fail = [&path]() {
+    return std::runtime_error("cannot write dataset " + path);
+  };
+  if (std::fwrite(&header, sizeof(header), 1, out.get()) != 1) throw fail();
+
+  Matrix inputs;
+  Matrix outputs;
+  std::vector<double> values;
+  source.seek(0);
+  for (uint64_t first = 0;;) {
+    const size_t rows = source.read(writeChunkRows, inputs, outputs);
+    if (!rows) break;
+    values.resize(rows);
+    for (uint64_t c = 0; c < columns; ++c) {
+      const bool input = c < header.input_count;
+      const Matrix &block = input ? inputs : outputs;
+      const size_t column = input ? c : c - header.input_count;
+      for (size_t r = 0; r < rows; ++r) values[r] = block(r, column);
+      if (!seekFile(out.get(), sizeof(header) + c * stride +
+                                   first * sizeof(double)) ||
+          std::fwrite(values.data(), sizeof(double), rows, out.get()) !=
+              rows) {
+        throw fail();
+      }
+    }
+    first += rows;
+  }
+  // pad the last column so every block is complete
+  const uint64_t total = sizeof(header) + columns * stride;
+  if (columns && stride > header.rows * sizeof(double)) {
+    const char zero = 0;
+    if (!seekFile(out.get(), total - 1) ||
+        std::fwrite(&zero, 1, 1, out.get()) != 1) {
+      throw fail();
+    }
+  }
+  if (std::fflush(out.get()) != 0) throw fail();
+}
+
+std::unique_ptr<NeuralNetwork::DatasetReader> NeuralNetwork::openDataset(
+    const std::string &path, size_t input_count, size_t output_count) {
+  std::string extension = path.substr(std::min(path.size(), path.rfind('.')));
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  if (extension == ".csv") {
+    return std::make_unique<CsvReader>(path, input_count, output_count);
+  }
+  return std::make_unique<ColumnarReader>(path);
+}
@@ -0,0 +1,104 @@
+#ifndef DATASET_H
+#define DATASET_H
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include "matrix.h"
+namespace NeuralNetwork {
+// Sequential source of training samples, each one inputCount() inputs
+// followed by outputCount() expected outputs. Readers keep only a bounded
+// window of the file in memory so datasets far larger than RAM can be
+// streamed. Errors are reported as std::runtime_error.
+class DatasetReader {
+ public:
+  virtual ~DatasetReader() = default;
+  virtual size_t inputCount() const = 0;
+  virtual size_t outputCount() const = 0;
+  virtual size_t rows() const = 0;
+  // positions the reader in front of the given sample
+  virtual void seek(size_t row) = 0;
+  // reads up to count samples into inputs and outputs, which are resized to
+  // the rows read. Returns that number, zero once the file is exhausted.
+  virtual size_t read(size_t count, Matrix &inputs, Matrix &outputs) = 0;
+};
+
+// Text samples, one per line with the values separated by commas,
+// semicolons or blanks. Lines that do not start with a number, like a
+// header or # comments, are skipped. Opening scans the file once to count
+// the samples and remember where every 1024th one starts, which keeps
+// seek() cheap.
+class CsvReader : public DatasetReader {
+ public:
+  CsvReader(const std::string &path, size_t input_count, size_t output_count);
+
+  size_t inputCount() const override { return input_count; }
+  size_t outputCount() const override { return output_count; }
+  size_t rows() const override { return row_count; }
+  void seek(size_t row) override;
+  size_t read(size_t count, Matrix &inputs, Matrix &outputs) override;
+
+ private:
+  bool nextLine(const char *&line, const char *&line_end);
+  void rewindTo(uint64_t offset);
+
+  std::string path;
+  std::unique_ptr<std::FILE, int (*)(std::FILE *)> file{nullptr, std::fclose};
+  size_t input_count;
+  size_t output_count;
+  size_t row_count{0};
+  size_t position{0};
+  // byte offset of every checkpointInterval-th sample
+  std::vector<uint64_t> checkpoints;
+  std::vector<char> buffer;
+  size_t buffer_begin{0};
+  size_t buffer_end{0};
+  uint64_t buffer_offset{0};
+  bool eof{false};
+};
+
+// Compact binary columnar dataset. A 64 byte header (magic, version, byte
+// order marker, input, output and row counts) is followed by one block of
+// rows doubles per column, inputs first, every block starting on a 64 byte
+// boundary. The file is memory mapped read only where the platform allows
+// and read column by column otherwise.
+class ColumnarReader : public DatasetReader {
+ public:
+  static constexpr uint32_t version = 1;
+
+  explicit ColumnarReader(const std::string &path);
+
+  size_t inputCount() const override { return input_count; }
+  size_t outputCount() const override { return output_count; }
+  size_t rows() const override { return row_count; }
+  void seek(size_t row) override;
+  size_t read(size_t count, Matrix &inputs, Matrix &outputs) override;
+
+  // converts everything source holds into a columnar file, streaming it in
+  // bounded chunks
+  static void write(DatasetReader &source, const std::string &path);
+
+ private:
+  const double *column(size_t index, size_t first, size_t count);
+
+  std::string path;
+  size_t input_count{0};
+  size_t output_count{0};
+  size_t row_count{0};
+  size_t position{0};
+  uint64_t column_stride{0};
+  std::shared_ptr<void> mapping;
+  const char *mapped{nullptr};
+  std::unique_ptr<std::FILE, int (*)(std::FILE *)> file{nullptr, std::fclose};
+  std::vector<double> scratch;
+};
+
+// opens path with the reader matching its extension, .csv files as text
+// with the given counts and everything else as a columnar file
+std::unique_ptr<DatasetReader> openDataset(const std::string &path,
+                                           size_t input_count,
+                                           size_t output_count);
+}  // namespace NeuralNetwork
+#endif  // DATASET_H
@@ -0,0 +1,68 @@
+#include "decimator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+NeuralNetwork::MinMaxDecimator::MinMaxDecimator(size_t buckets)
+    : bucket_count(buckets) {
+  if (!buckets) throw std::invalid_argument("decimation needs buckets");
+  closed.reserve(2 * buckets);
+}
+
+void NeuralNetwork::MinMaxDecimator::clear() {
+  width = 1;
+  closed.clear();
+  open_points = 0;
+  appended = 0;
+}
+
+void NeuralNetwork::MinMaxDecimator::append(double x, double y) {
+  const Point point{x, y};
+  if (open_points == 0) {
+    open = {point, point};
+  } else {
+    if (y < open.low.y) open.low = point;
+    if (y > open.high.y) open.high = point;
+  }
+  lowest = appended ? std::min(lowest, y) : y;
+  highest = appended ? std::max(highest, y) : y;
+  last = point;
+  ++appended;
+  if (++open_points < width) return;
+
+  closed.push_back(open);
+  open_points = 0;
+  if (closed.size() < 2 * bucket_count) return;
+  for (size_t b = 0; b < bucket_count; ++b) {
+    closed[b] = merge(closed[2 * b], closed[2 * b + 1]);
+  }
+  closed.resize(bucket_count);
+  width *= 2;
+}
+
+NeuralNetwork::MinMaxDecimator::Bucket
+NeuralNetwork::MinMaxDecimator::merge(const Bucket &first,
+                                      const Bucket &second) {
+  // ties keep the earlier point
+  return {second.low.y < first.low.y ? second.low : first.low,
+          second.high.y > first.high.y ? second.high : first.high};
+}
+
+std::vector<NeuralNetwork::MinMaxDecimator::Point>
+NeuralNetwork::MinMaxDecimator::points() const {
+  std::vector<Point> series;
+  series.reserve(2 * closed.size() + 3);
+  auto add = [&series](const Bucket &bucket) {
+    const bool low_first = bucket.low.x <= bucket.high.x;
+    series.push_back(low_first ? bucket.low : bucket.high);
+    if (bucket.low.x != bucket.high.x) {
+      series.push_back(low_first ? bucket.high : bucket.low);
+    }
+  };
+  for (const Bucket &bucket : closed) add(bucket);
+  if (open_points) add(open);
+  if (appended && (series.empty() || series.back().x != last.x)) {
+    series.push_back(last);
+  }
+  return series;
+}
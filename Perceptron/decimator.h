@@ -0,0 +1,51 @@
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+#include <cstddef>
+#include <vector>
+namespace NeuralNetwork {
+// Running min/max decimation of a series whose x only grows, e.g. the loss
+// per epoch. The points are counted into buckets of equal point count and
+// every bucket keeps its lowest and highest point, so spikes stay visible
+// however long the series gets. Whenever the closed buckets reach twice the
+// requested count, neighbours merge and the bucket width doubles. append()
+// is O(1) amortized and the memory stays bounded by the bucket count.
+class MinMaxDecimator {
+ public:
+  struct Point {
+    double x;
+    double y;
+  };
+
+  explicit MinMaxDecimator(size_t buckets = 1024);
+
+  void clear();
+  void append(double x, double y);
+  // points appended since the last clear()
+  size_t count() const { return appended; }
+  double minimum() const { return lowest; }
+  double maximum() const { return highest; }
+  // the decimated series in x order, at most 4 * buckets + 1 points, always
+  // ending with the last point appended
+  std::vector<Point> points() const;
+
+ private:
+  struct Bucket {
+    Point low;
+    Point high;
+  };
+
+  static Bucket merge(const Bucket &first, const Bucket &second);
+
+  size_t bucket_count;
+  // points per closed bucket
+  size_t width{1};
+  std::vector<Bucket> closed;
+  Bucket open{};
+  size_t open_points{0};
+  Point last{};
+  size_t appended{0};
+  double lowest{0.0};
+  double highest{0.0};
+};
+}  // namespace NeuralNetwork
+#endif  // DECIMATOR_H
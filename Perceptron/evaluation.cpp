@@ -0,0 +1,151 @@
+#include "evaluation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+constexpr double probabilityFloor = 1e-12;
+
+size_t classCount(size_t outputs) { return outputs == 1 ? 2 : outputs; }
+
+size_t predictedClass(const double *values, size_t count) {
+  if (count == 1) return values[0] >= 0.5;
+  return static_cast<size_t>(std::max_element(values, values + count) -
+                             values);
+}
+}  // namespace
+
+NeuralNetwork::Evaluator::Evaluator(size_t threads, size_t batch_size)
+    : pool(std::max<size_t>(threads, 1)),
+      batch_size(std::max<size_t>(batch_size, 1)),
+      accumulators(pool.size()) {}
+
+void NeuralNetwork::Evaluator::reset(size_t classes) {
+  for (auto &accumulator : accumulators) {
+    accumulator.confusion.assign(classes * classes, 0);
+    accumulator.squared_error = 0.0;
+    accumulator.cross_entropy = 0.0;
+    accumulator.correct = 0;
+    accumulator.samples = 0;
+  }
+}
+
+// Predicts the first rows samples held in the accumulator and adds them to
+// its sums.
+void NeuralNetwork::Evaluator::accumulate(Accumulator &accumulator,
+                                          const NeuralNetwork &network,
+                                          size_t rows) {
+  network.predictBatch(accumulator.inputs, accumulator.results);
+  const size_t outputs = accumulator.results.cols();
+  const size_t classes = classCount(outputs);
+  double squared_error = 0.0;
+  double cross_entropy = 0.0;
+  for (size_t r = 0; r < rows; ++r) {
+    const double *result = accumulator.results.row(r);
+    const double *expected = accumulator.outputs.row(r);
+    for (size_t k = 0; k < outputs; ++k) {
+      const double error = expected[k] - result[k];
+      squared_error += error * error;
+      const double p =
+          std::min(std::max(result[k], probabilityFloor), 1.0 - probabilityFloor);
+      cross_entropy -=
+          expected[k] * std::log(p) + (1.0 - expected[k]) * std::log(1.0 - p);
+    }
+    const size_t actual = predictedClass(expected, outputs);
+    const size_t predicted = predictedClass(result, outputs);
+    accumulator.correct += actual == predicted;
+    ++accumulator.confusion[actual * classes + predicted];
+  }
+  accumulator.squared_error += squared_error;
+  accumulator.cross_entropy += cross_entropy;
+  accumulator.samples += rows;
+}
+
+NeuralNetwork::Evaluation NeuralNetwork::Evaluator::merge(
+    size_t classes, size_t outputs) const {
+  Evaluation evaluation;
+  evaluation.classes = classes;
+  evaluation.confusion.assign(classes * classes, 0);
+  size_t correct = 0;
+  for (const auto &accumulator : accumulators) {
+    evaluation.samples += accumulator.samples;
+    evaluation.mean_squared_error += accumulator.squared_error;
+    evaluation.cross_entropy += accumulator.cross_entropy;
+    correct += accumulator.correct;
+    std::transform(accumulator.confusion.begin(), accumulator.confusion.end(),
+                   evaluation.confusion.begin(), evaluation.confusion.begin(),
+                   std::plus<>());
+  }
+  if (evaluation.samples) {
+    const auto samples = static_cast<double>(evaluation.samples);
+    evaluation.accuracy = static_cast<double>(correct) / samples;
+    evaluation.mean_squared_error /= samples * static_cast<double>(outputs);
+    evaluation.cross_entropy /= samples;
+  }
+  return evaluation;
+}
+
+// every thread walks a contiguous range of batches with its own accumulator
+NeuralNetwork::Evaluation NeuralNetwork::Evaluator::evaluate(
+    const NeuralNetwork &network, const SampleView &samples) {
+  if (samples.inputCount() != network.inputCount() ||
+      samples.outputCount() != network.outputCount()) {
+    throw std::invalid_argument("samples do not match the network");
+  }
+  const size_t inputs = network.inputCount();
+  const size_t outputs = network.outputCount();
+  const size_t classes = classCount(outputs);
+  reset(classes);
+  const size_t batches = (samples.size() + batch_size - 1) / batch_size;
+  const size_t shards = std::min(accumulators.size(), batches);
+  pool.run(shards, [&](size_t s) {
+    Accumulator &accumulator = accumulators[s];
+    for (size_t b = batches * s / shards; b < batches * (s + 1) / shards;
+         ++b) {
+      const size_t first = b * batch_size;
+      const size_t rows = std::min(batch_size, samples.size() - first);
+      accumulator.inputs.resize(rows, inputs);
+      accumulator.outputs.resize(rows, outputs);
+      for (size_t r = 0; r < rows; ++r) {
+        std::copy_n(samples.input(first + r), inputs,
+                    accumulator.inputs.row(r));
+        std::copy_n(samples.output(first + r), outputs,
+                    accumulator.outputs.row(r));
+      }
+      accumulate(accumulator, network, rows);
+    }
+  });
+  return merge(classes, outputs);
+}
+
+// the stream hands out batches in order, each one is split across the
+// threads while the stream prefetches the next
+NeuralNetwork::Evaluation NeuralNetwork::Evaluator::evaluate(
+    const NeuralNetwork &network, BatchStream &stream) {
+  if (stream.inputCount() != network.inputCount() ||
+      stream.outputCount() != network.outputCount()) {
+    throw std::invalid_argument("dataset does not match the network");
+  }
+  const size_t outputs = network.outputCount();
+  const size_t classes = classCount(outputs);
+  reset(classes);
+  stream.rewind();
+  while (const Batch *batch = stream.next()) {
+    const size_t count = batch->rows();
+    const size_t shards = std::min(accumulators.size(), count);
+    pool.run(shards, [&](size_t s) {
+      const size_t begin = count * s / shards;
+      const size_t end = count * (s + 1) / shards;
+      Accumulator &accumulator = accumulators[s];
+      accumulator.inputs.resize(end - begin, batch->inputs.cols());
+      accumulator.outputs.resize(end - begin, outputs);
+      std::copy(batch->inputs.row(begin), batch->inputs.row(end),
+                accumulator.inputs.begin());
+      std::copy(batch->outputs.row(begin), batch->outputs.row(end),
+                accumulator.outputs.begin());
+      accumulate(accumulator, network, end - begin);
+    });
+  }
+  return merge(classes, outputs);
+}
@@ -0,0 +1,67 @@
+#ifndef EVALUATION_H
+#define EVALUATION_H
+#include <thread>
+#include <vector>
+#include "batchstream.h"
+#include "matrix.h"
+#include "network.h"
+#include "samples.h"
+#include "threadpool.h"
+namespace NeuralNetwork {
+// Metrics of a network on a set of samples. The class of a sample is its
+// strongest output, a network with a single output is read as a yes/no
+// classifier split at 0.5.
+struct Evaluation {
+  size_t samples{0};
+  size_t classes{0};
+  // share of samples whose predicted class is the expected one
+  double accuracy{0.0};
+  // mean over samples and outputs of the squared error
+  double mean_squared_error{0.0};
+  // mean over samples of the binary cross-entropy summed over the outputs,
+  // meaningful for outputs in (0, 1) such as the logistic activation
+  double cross_entropy{0.0};
+  // classes x classes counts, row is the expected and column the predicted
+  // class
+  std::vector<size_t> confusion;
+
+  size_t confusionCount(size_t expected, size_t predicted) const {
+    return confusion[expected * classes + predicted];
+  }
+};
+
+// Runs samples through a network in batches spread over a thread pool and
+// computes every metric of an Evaluation in a single pass. Each thread sums
+// into its own accumulator, the accumulators are merged at the end. The
+// network is only read, through predictBatch.
+class Evaluator {
+ public:
+  explicit Evaluator(size_t threads = std::thread::hardware_concurrency(),
+                     size_t batch_size = 256);
+
+  Evaluation evaluate(const NeuralNetwork &network, const SampleView &samples);
+  // one pass over the stream from its first sample
+  Evaluation evaluate(const NeuralNetwork &network, BatchStream &stream);
+
+ private:
+  struct Accumulator {
+    Matrix inputs;
+    Matrix outputs;
+    Matrix results;
+    std::vector<size_t> confusion;
+    double squared_error{0.0};
+    double cross_entropy{0.0};
+    size_t correct{0};
+    size_t samples{0};
+  };
+  void reset(size_t classes);
+  void accumulate(Accumulator &accumulator, const NeuralNetwork &network,
+                  size_t rows);
+  Evaluation merge(size_t classes, size_t outputs) const;
+
+  ThreadPool pool;
+  size_t batch_size;
+  std::vector<Accumulator> accumulators;
+};
+}  // namespace NeuralNetwork
+#endif  // EVALUATION_H
@@ -0,0 +1,131 @@
+#include "generator.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+constexpr double pi = 3.14159265358979323846;
+// rows below this are not worth handing to another thread
+constexpr size_t minimumShardRows = 1024;
+
+// streams of the generator, the counter's last word tells them apart
+enum Stream : uint32_t { SampleStream = 0, CenterStream = 1 };
+
+using Block = std::array<uint32_t, 4>;
+
+// Philox4x32-10 by Salmon et al., "Parallel random numbers: as easy as
+// 1, 2, 3". Maps a 128 bit counter under a 64 bit key to 128 random bits.
+Block philox(Block counter, uint64_t seed) {
+  uint32_t key0 = static_cast<uint32_t>(seed);
+  uint32_t key1 = static_cast<uint32_t>(seed >> 32);
+  for (int round = 0; round < 10; ++round) {
+    const uint64_t product0 = uint64_t{0xD2511F53} * counter[0];
+    const uint64_t product1 = uint64_t{0xCD9E8D57} * counter[2];
+    counter = {static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ key0,
+               static_cast<uint32_t>(product1),
+               static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ key1,
+               static_cast<uint32_t>(product0)};
+    key0 += 0x9E3779B9;
+    key1 += 0xBB67AE85;
+  }
+  return counter;
+}
+
+// the two uniform doubles in (0, 1) of a block, 53 bits each
+std::array<double, 2> uniforms(const Block &bits) {
+  constexpr double scale = 1.0 / 9007199254740992.0;  // 2^-53
+  auto uniform = [scale](uint32_t high, uint32_t low) {
+    const uint64_t value = ((uint64_t{high} << 32) | low) >> 11;
+    return (static_cast<double>(value) + 0.5) * scale;
+  };
+  return {uniform(bits[0], bits[1]), uniform(bits[2], bits[3])};
+}
+
+Block counterOf(uint64_t row, size_t pair, Stream stream) {
+  return {static_cast<uint32_t>(row), static_cast<uint32_t>(row >> 32),
+          static_cast<uint32_t>(pair), stream};
+}
+}  // namespace
+
+NeuralNetwork::ClusterGenerator::ClusterGenerator(const ClusterSpec &spec,
+                                                  size_t threads)
+    : spec(spec),
+      center_values(spec.classes, spec.inputs),
+      pool(std::max<size_t>(threads, 1)) {
+  if (!spec.classes || !spec.inputs) {
+    throw std::invalid_argument("clusters need classes and inputs");
+  }
+  for (size_t c = 0; c < spec.classes; ++c) {
+    for (size_t k = 0; k < spec.inputs; k += 2) {
+      const auto u = uniforms(philox(counterOf(c, k / 2, CenterStream), spec.seed));
+      center_values(c, k) = u[0] * spec.center_range;
+      if (k + 1 < spec.inputs) center_values(c, k + 1) = u[1] * spec.center_range;
+    }
+  }
+}
+
+void NeuralNetwork::ClusterGenerator::seek(size_t row) {
+  position = std::min(row, spec.samples);
+}
+
+size_t NeuralNetwork::ClusterGenerator::read(size_t count, Matrix &inputs,
+                                             Matrix &outputs) {
+  const size_t rows = std::min(count, spec.samples - position);
+  inputs.resize(rows, spec.inputs);
+  outputs.resize(rows, spec.classes);
+  generateParallel(position, rows, inputs.data(), outputs.data());
+  position += rows;
+  return rows;
+}
+
+// Every Philox block turns into two normal values through the Box-Muller
+// transform, so inputs 2j and 2j + 1 of a row share block j.
+void NeuralNetwork::ClusterGenerator::generate(size_t first, size_t count,
+                                               double *inputs,
+                                               double *outputs) const {
+  const size_t input_count = spec.inputs;
+  const size_t classes = spec.classes;
+  std::fill(outputs, outputs + count * classes, 0.0);
+  for (size_t r = 0; r < count; ++r) {
+    const uint64_t row = first + r;
+    const size_t label = static_cast<size_t>(row % classes);
+    const double *center = center_values.row(label);
+    double *sample = inputs + r * input_count;
+    for (size_t k = 0; k < input_count; k += 2) {
+      const auto u = uniforms(philox(counterOf(row, k / 2, SampleStream),
+                                     spec.seed));
+      const double radius = spec.spread * std::sqrt(-2.0 * std::log(u[0]));
+      const double angle = 2.0 * pi * u[1];
+      sample[k] = center[k] + radius * std::cos(angle);
+      if (k + 1 < input_count) {
+        sample[k + 1] = center[k + 1] + radius * std::sin(angle);
+      }
+    }
+    outputs[r * classes + label] = 1.0;
+  }
+}
+
+void NeuralNetwork::ClusterGenerator::generateParallel(size_t first,
+                                                       size_t count,
+                                                       double *inputs,
+                                                       double *outputs) {
+  const size_t shards =
+      std::min(pool.size(), (count + minimumShardRows - 1) / minimumShardRows);
+  pool.run(shards, [&](size_t s) {
+    const size_t begin = count * s / shards;
+    const size_t end = count * (s + 1) / shards;
+    generate(first + begin, end - begin, inputs + begin * spec.inputs,
+             outputs + begin * spec.classes);
+  });
+}
+
+std::shared_ptr<NeuralNetwork::SampleStore>
+NeuralNetwork::ClusterGenerator::generateStore() {
+  auto store =
+      std::make_shared<SampleStore>(spec.samples, spec.inputs, spec.classes);
+  generateParallel(0, spec.samples, store->inputs.data(),
+                   store->outputs.data());
+  return store;
+}
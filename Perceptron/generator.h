@@ -0,0 +1,65 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include "dataset.h"
+#include "matrix.h"
+#include "samples.h"
+#include "threadpool.h"
+namespace NeuralNetwork {
+// Gaussian clusters, one per class. Sample n belongs to class n % classes,
+// its inputs are normally distributed around the class center with the
+// given spread and its outputs are the one-hot class.
+struct ClusterSpec {
+  size_t classes{2};
+  size_t inputs{2};
+  size_t samples{1000};
+  // every center coordinate is uniform in [0, center_range)
+  double center_range{1000.0};
+  // standard deviation of the inputs around their center
+  double spread{3.0};
+  uint64_t seed{0};
+};
+
+// Synthetic cluster dataset computed on demand. Every value is a pure
+// function of the seed and its row and column, drawn from a counter-based
+// generator (Philox4x32-10) rather than a sequential engine, so any range of
+// rows can be produced independently: the same seed yields the same samples
+// whatever the number of threads, chunk sizes or order of the reads.
+//
+// As a DatasetReader it streams samples of any count into a BatchStream or,
+// through ColumnarReader::write, into a columnar file, producing every chunk
+// in parallel on its pool. generateStore() fills one contiguous store.
+class ClusterGenerator : public DatasetReader {
+ public:
+  explicit ClusterGenerator(const ClusterSpec &spec,
+                            size_t threads = std::thread::hardware_concurrency());
+
+  size_t inputCount() const override { return spec.inputs; }
+  size_t outputCount() const override { return spec.classes; }
+  size_t rows() const override { return spec.samples; }
+  void seek(size_t row) override;
+  size_t read(size_t count, Matrix &inputs, Matrix &outputs) override;
+
+  // writes the samples [first, first + count) row-major into inputs and
+  // outputs, which hold count rows of inputCount() and outputCount() values
+  void generate(size_t first, size_t count, double *inputs,
+                double *outputs) const;
+  // all samples, generated in parallel straight into the store
+  std::shared_ptr<SampleStore> generateStore();
+  // classes x inputs
+  const Matrix &centers() const { return center_values; }
+
+ private:
+  // spreads [first, first + count) over the pool
+  void generateParallel(size_t first, size_t count, double *inputs,
+                        double *outputs);
+
+  ClusterSpec spec;
+  Matrix center_values;
+  ThreadPool pool;
+  size_t position{0};
+};
+}  // namespace NeuralNetwork
+#endif  // GENERATOR_H
@@ -0,0 +1,504 @@
+#include "kernels.h"
+
+#include <cmath>
+#include <cstdint>
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+// exp() saturates outside of this range, clamping keeps the bit tricks below
+// away from denormals and infinities
+constexpr double expLimit = 708.0;
+
+double dotScalar(const double *a, const double *b, size_t size) {
+  double sum0 = 0.0, sum1 = 0.0, sum2 = 0.0, sum3 = 0.0;
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    sum0 += a[i] * b[i];
+    sum1 += a[i + 1] * b[i + 1];
+    sum2 += a[i + 2] * b[i + 2];
+    sum3 += a[i + 3] * b[i + 3];
+  }
+  for (; i < size; ++i) sum0 += a[i] * b[i];
+  return (sum0 + sum1) + (sum2 + sum3);
+}
+
+double gatherDotScalar(const double *values, const uint32_t *columns,
+                       size_t count, const double *x) {
+  double sum0 = 0.0, sum1 = 0.0, sum2 = 0.0, sum3 = 0.0;
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    sum0 += values[i] * x[columns[i]];
+    sum1 += values[i + 1] * x[columns[i + 1]];
+    sum2 += values[i + 2] * x[columns[i + 2]];
+    sum3 += values[i + 3] * x[columns[i + 3]];
+  }
+  for (; i < count; ++i) sum0 += values[i] * x[columns[i]];
+  return (sum0 + sum1) + (sum2 + sum3);
+}
+
+void logisticScalar(const double *in, double *out, size_t size, double beta,
+                    double theta) {
+  for (size_t i = 0; i < size; ++i)
+    out[i] = 1.0 / (1.0 + std::exp(-beta * (in[i] - theta)));
+}
+
+void hypertanScalar(const double *in, double *out, size_t size,
+                    double theta) {
+  for (size_t i = 0; i < size; ++i) out[i] = std::tanh(in[i] - theta);
+}
+
+float dotFloatScalar(const float *a, const float *b, size_t size) {
+  float sum0 = 0.0f, sum1 = 0.0f, sum2 = 0.0f, sum3 = 0.0f;
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    sum0 += a[i] * b[i];
+    sum1 += a[i + 1] * b[i + 1];
+    sum2 += a[i + 2] * b[i + 2];
+    sum3 += a[i + 3] * b[i + 3];
+  }
+  for (; i < size; ++i) sum0 += a[i] * b[i];
+  return (sum0 + sum1) + (sum2 + sum3);
+}
+
+int32_t dotInt8Scalar(const int8_t *a, const int8_t *b, size_t size) {
+  int32_t sum = 0;
+  for (size_t i = 0; i < size; ++i) sum += int32_t{a[i]} * int32_t{b[i]};
+  return sum;
+}
+
+void logisticFloatScalar(const float *in, float *out, size_t size,
+                         float beta, float theta) {
+  for (size_t i = 0; i < size; ++i)
+    out[i] = 1.0f / (1.0f + std::exp(-beta * (in[i] - theta)));
+}
+
+void hypertanFloatScalar(const float *in, float *out, size_t size,
+                         float theta) {
+  for (size_t i = 0; i < size; ++i) out[i] = std::tanh(in[i] - theta);
+}
+
+#ifdef KERNELS_X86
+// exp(x) = 2^n * exp(r) with |r| <= ln(2)/2, exp(r) from its Taylor series
+// to degree 11 which is accurate to a few ulp over that range.
+__attribute__((target("avx2,fma"))) inline __m256d exp256(__m256d x) {
+  x = _mm256_min_pd(_mm256_max_pd(x, _mm256_set1_pd(-expLimit)),
+                    _mm256_set1_pd(expLimit));
+  const __m256d n = _mm256_round_pd(
+      _mm256_mul_pd(x, _mm256_set1_pd(1.4426950408889634)),
+      _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m256d r = _mm256_fnmadd_pd(n, _mm256_set1_pd(6.93145751953125e-1), x);
+  r = _mm256_fnmadd_pd(n, _mm256_set1_pd(1.42860682030941723212e-6), r);
+  __m256d p = _mm256_set1_pd(1.0 / 39916800.0);
+  p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 3628800.0));
+  p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 362880.0));
+  p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 40320.0));
+  p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 5040.0));
+  p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 720.0));
+  p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 120.0));
+  p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 24.0));
+  p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 6.0));
+  p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(0.5));
+  p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0));
+  p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0));
+  // adding 1.5 * 2^52 leaves n + 1023 in the low mantissa bits, shifting
+  // them into the exponent field gives 2^n
+  const __m256d biased =
+      _mm256_add_pd(n, _mm256_set1_pd(6755399441055744.0 + 1023.0));
+  const __m256i bits = _mm256_slli_epi64(_mm256_castpd_si256(biased), 52);
+  return _mm256_mul_pd(p, _mm256_castsi256_pd(bits));
+}
+
+__attribute__((target("avx2,fma"))) double dotAvx2(const double *a,
+                                                   const double *b,
+                                                   size_t size) {
+  __m256d sum0 = _mm256_setzero_pd();
+  __m256d sum1 = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    sum0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i),
+                           sum0);
+    sum1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4),
+                           _mm256_loadu_pd(b + i + 4), sum1);
+  }
+  for (; i + 4 <= size; i += 4) {
+    sum0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i),
+                           sum0);
+  }
+  sum0 = _mm256_add_pd(sum0, sum1);
+  __m128d half = _mm_add_pd(_mm256_castpd256_pd128(sum0),
+                            _mm256_extractf128_pd(sum0, 1));
+  double sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+  for (; i < size; ++i) sum += a[i] * b[i];
+  return sum;
+}
+
+// the masked gathers spell out their pass-through operand, GCC warns about
+// the undefined one of the plain _mm256_i32gather_pd
+__attribute__((target("avx2,fma"))) double gatherDotAvx2(
+    const double *values, const uint32_t *columns, size_t count,
+    const double *x) {
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+  __m256d sum0 = _mm256_setzero_pd();
+  __m256d sum1 = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m128i low =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(columns + i));
+    const __m128i high =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(columns + i + 4));
+    sum0 = _mm256_fmadd_pd(_mm256_loadu_pd(values + i),
+                           _mm256_mask_i32gather_pd(zero, x, low, all, 8),
+                           sum0);
+    sum1 = _mm256_fmadd_pd(_mm256_loadu_pd(values + i + 4),
+                           _mm256_mask_i32gather_pd(zero, x, high, all, 8),
+                           sum1);
+  }
+  sum0 = _mm256_add_pd(sum0, sum1);
+  __m128d half = _mm_add_pd(_mm256_castpd256_pd128(sum0),
+                            _mm256_extractf128_pd(sum0, 1));
+  double sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+  for (; i < count; ++i) sum += values[i] * x[columns[i]];
+  return sum;
+}
+
+__attribute__((target("avx2,fma"))) void logisticAvx2(const double *in,
+                                                      double *out, size_t size,
+                                                      double beta,
+                                                      double theta) {
+  const __m256d shift = _mm256_set1_pd(theta);
+  const __m256d scale = _mm256_set1_pd(-beta);
+  const __m256d one = _mm256_set1_pd(1.0);
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    __m256d e = exp256(
+        _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(in + i), shift), scale));
+    _mm256_storeu_pd(out + i, _mm256_div_pd(one, _mm256_add_pd(one, e)));
+  }
+  logisticScalar(in + i, out + i, size - i, beta, theta);
+}
+
+__attribute__((target("avx2,fma"))) void hypertanAvx2(const double *in,
+                                                      double *out, size_t size,
+                                                      double theta) {
+  // tanh(x) = 2 / (1 + exp(-2x)) - 1
+  const __m256d shift = _mm256_set1_pd(theta);
+  const __m256d scale = _mm256_set1_pd(-2.0);
+  const __m256d one = _mm256_set1_pd(1.0);
+  const __m256d two = _mm256_set1_pd(2.0);
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    __m256d e = exp256(
+        _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(in + i), shift), scale));
+    __m256d t = _mm256_div_pd(two, _mm256_add_pd(one, e));
+    _mm256_storeu_pd(out + i, _mm256_sub_pd(t, one));
+  }
+  hypertanScalar(in + i, out + i, size - i, theta);
+}
+
+// single precision variant of exp256, degree 7 is enough for float
+__attribute__((target("avx2,fma"))) inline __m256 exp256(__m256 x) {
+  x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-87.0f)),
+                    _mm256_set1_ps(87.0f));
+  const __m256 n = _mm256_round_ps(
+      _mm256_mul_ps(x, _mm256_set1_ps(1.44269504f)),
+      _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(0.693359375f), x);
+  r = _mm256_fnmadd_ps(n, _mm256_set1_ps(-2.12194440e-4f), r);
+  __m256 p = _mm256_set1_ps(1.0f / 5040.0f);
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f / 720.0f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f / 120.0f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f / 24.0f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f / 6.0f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(0.5f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f));
+  const __m256i bits = _mm256_slli_epi32(
+      _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+  return _mm256_mul_ps(p, _mm256_castsi256_ps(bits));
+}
+
+__attribute__((target("avx2,fma"))) float dotFloatAvx2(const float *a,
+                                                       const float *b,
+                                                       size_t size) {
+  __m256 sum0 = _mm256_setzero_ps();
+  __m256 sum1 = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i),
+                           sum0);
+    sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8),
+                           _mm256_loadu_ps(b + i + 8), sum1);
+  }
+  for (; i + 8 <= size; i += 8) {
+    sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i),
+                           sum0);
+  }
+  sum0 = _mm256_add_ps(sum0, sum1);
+  __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum0),
+                           _mm256_extractf128_ps(sum0, 1));
+  half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+  float sum = _mm_cvtss_f32(_mm_add_ss(half, _mm_movehdup_ps(half)));
+  for (; i < size; ++i) sum += a[i] * b[i];
+  return sum;
+}
+
+// widens 16 int8 lanes at a time to int16 and lets madd pair them up into
+// int32 partial sums
+__attribute__((target("avx2"))) int32_t dotInt8Avx2(const int8_t *a,
+                                                    const int8_t *b,
+                                                    size_t size) {
+  __m256i sum = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    const __m256i wide_a = _mm256_cvtepi8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)));
+    const __m256i wide_b = _mm256_cvtepi8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)));
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(wide_a, wide_b));
+  }
+  __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                               _mm256_extracti128_si256(sum, 1));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+  return _mm_cvtsi128_si32(half) + dotInt8Scalar(a + i, b + i, size - i);
+}
+
+__attribute__((target("avx2,fma"))) void logisticFloatAvx2(const float *in,
+                                                           float *out,
+                                                           size_t size,
+                                                           float beta,
+                                                           float theta) {
+  const __m256 shift = _mm256_set1_ps(theta);
+  const __m256 scale = _mm256_set1_ps(-beta);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m256 e = exp256(
+        _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(in + i), shift), scale));
+    _mm256_storeu_ps(out + i, _mm256_div_ps(one, _mm256_add_ps(one, e)));
+  }
+  logisticFloatScalar(in + i, out + i, size - i, beta, theta);
+}
+
+__attribute__((target("avx2,fma"))) void hypertanFloatAvx2(const float *in,
+                                                           float *out,
+                                                           size_t size,
+                                                           float theta) {
+  const __m256 shift = _mm256_set1_ps(theta);
+  const __m256 scale = _mm256_set1_ps(-2.0f);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 two = _mm256_set1_ps(2.0f);
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m256 e = exp256(
+        _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(in + i), shift), scale));
+    __m256 t = _mm256_div_ps(two, _mm256_add_ps(one, e));
+    _mm256_storeu_ps(out + i, _mm256_sub_ps(t, one));
+  }
+  hypertanFloatScalar(in + i, out + i, size - i, theta);
+}
+
+// GCC flags the placeholder operands inside its own AVX-512 intrinsics
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+__attribute__((target("avx512f"))) inline __m512d exp512(__m512d x) {
+  x = _mm512_min_pd(_mm512_max_pd(x, _mm512_set1_pd(-expLimit)),
+                    _mm512_set1_pd(expLimit));
+  const __m512d n = _mm512_roundscale_pd(
+      _mm512_mul_pd(x, _mm512_set1_pd(1.4426950408889634)),
+      _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m512d r = _mm512_fnmadd_pd(n, _mm512_set1_pd(6.93145751953125e-1), x);
+  r = _mm512_fnmadd_pd(n, _mm512_set1_pd(1.42860682030941723212e-6), r);
+  __m512d p = _mm512_set1_pd(1.0 / 39916800.0);
+  p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0 / 3628800.0));
+  p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0 / 362880.0));
+  p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0 / 40320.0));
+  p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0 / 5040.0));
+  p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0 / 720.0));
+  p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0 / 120.0));
+  p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0 / 24.0));
+  p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0 / 6.0));
+  p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(0.5));
+  p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0));
+  p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0));
+  const __m512d biased =
+      _mm512_add_pd(n, _mm512_set1_pd(6755399441055744.0 + 1023.0));
+  const __m512i bits = _mm512_slli_epi64(_mm512_castpd_si512(biased), 52);
+  return _mm512_mul_pd(p, _mm512_castsi512_pd(bits));
+}
+
+__attribute__((target("avx512f"))) double dotAvx512(const double *a,
+                                                    const double *b,
+                                                    size_t size) {
+  __m512d sum0 = _mm512_setzero_pd();
+  __m512d sum1 = _mm512_setzero_pd();
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    sum0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i),
+                           sum0);
+    sum1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 8),
+                           _mm512_loadu_pd(b + i + 8), sum1);
+  }
+  if (i + 8 <= size) {
+    sum0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i),
+                           sum0);
+    i += 8;
+  }
+  if (i < size) {
+    const __mmask8 tail = static_cast<__mmask8>((1u << (size - i)) - 1);
+    sum1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(tail, a + i),
+                           _mm512_maskz_loadu_pd(tail, b + i), sum1);
+  }
+  return _mm512_reduce_add_pd(_mm512_add_pd(sum0, sum1));
+}
+
+// the tail stays scalar, masked 32 bit index loads would need AVX-512VL
+__attribute__((target("avx512f"))) double gatherDotAvx512(
+    const double *values, const uint32_t *columns, size_t count,
+    const double *x) {
+  __m512d sum0 = _mm512_setzero_pd();
+  __m512d sum1 = _mm512_setzero_pd();
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const __m256i low =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(columns + i));
+    const __m256i high =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(columns + i + 8));
+    sum0 = _mm512_fmadd_pd(_mm512_loadu_pd(values + i),
+                           _mm512_i32gather_pd(low, x, 8), sum0);
+    sum1 = _mm512_fmadd_pd(_mm512_loadu_pd(values + i + 8),
+                           _mm512_i32gather_pd(high, x, 8), sum1);
+  }
+  double sum = _mm512_reduce_add_pd(_mm512_add_pd(sum0, sum1));
+  for (; i < count; ++i) sum += values[i] * x[columns[i]];
+  return sum;
+}
+
+__attribute__((target("avx512f"))) void logisticAvx512(const double *in,
+                                                       double *out,
+                                                       size_t size,
+                                                       double beta,
+                                                       double theta) {
+  const __m512d shift = _mm512_set1_pd(theta);
+  const __m512d scale = _mm512_set1_pd(-beta);
+  const __m512d one = _mm512_set1_pd(1.0);
+  for (size_t i = 0; i < size; i += 8) {
+    const __mmask8 mask =
+        size - i >= 8 ? 0xFF : static_cast<__mmask8>((1u << (size - i)) - 1);
+    __m512d e = exp512(_mm512_mul_pd(
+        _mm512_sub_pd(_mm512_maskz_loadu_pd(mask, in + i), shift), scale));
+    _mm512_mask_storeu_pd(out + i, mask,
+                          _mm512_div_pd(one, _mm512_add_pd(one, e)));
+  }
+}
+
+__attribute__((target("avx512f"))) void hypertanAvx512(const double *in,
+                                                       double *out,
+                                                       size_t size,
+                                                       double theta) {
+  const __m512d shift = _mm512_set1_pd(theta);
+  const __m512d scale = _mm512_set1_pd(-2.0);
+  const __m512d one = _mm512_set1_pd(1.0);
+  const __m512d two = _mm512_set1_pd(2.0);
+  for (size_t i = 0; i < size; i += 8) {
+    const __mmask8 mask =
+        size - i >= 8 ? 0xFF : static_cast<__mmask8>((1u << (size - i)) - 1);
+    __m512d e = exp512(_mm512_mul_pd(
+        _mm512_sub_pd(_mm512_maskz_loadu_pd(mask, in + i), shift), scale));
+    __m512d t = _mm512_div_pd(two, _mm512_add_pd(one, e));
+    _mm512_mask_storeu_pd(out + i, mask, _mm512_sub_pd(t, one));
+  }
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+struct Dispatch {
+  double (*dot)(const double *, const double *, size_t);
+  double (*gatherDot)(const double *, const uint32_t *, size_t,
+                      const double *);
+  void (*logistic)(const double *, double *, size_t, double, double);
+  void (*hypertan)(const double *, double *, size_t, double);
+  float (*dotFloat)(const float *, const float *, size_t);
+  int32_t (*dotInt8)(const int8_t *, const int8_t *, size_t);
+  void (*logisticFloat)(const float *, float *, size_t, float, float);
+  void (*hypertanFloat)(const float *, float *, size_t, float);
+  const char *name;
+};
+
+// the reduced precision kernels only come in an AVX2 flavour, AVX-512 CPUs
+// run those
+Dispatch selectKernels() {
+#ifdef KERNELS_X86
+  __builtin_cpu_init();
+  const bool avx2 =
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  if (__builtin_cpu_supports("avx512f") && avx2)
+    return {dotAvx512,         gatherDotAvx512,   logisticAvx512,
+            hypertanAvx512,    dotFloatAvx2,      dotInt8Avx2,
+            logisticFloatAvx2, hypertanFloatAvx2, "avx512"};
+  if (avx2)
+    return {dotAvx2,           gatherDotAvx2,     logisticAvx2,
+            hypertanAvx2,      dotFloatAvx2,      dotInt8Avx2,
+            logisticFloatAvx2, hypertanFloatAvx2, "avx2"};
+#endif
+  return {dotScalar,           gatherDotScalar, logisticScalar,
+          hypertanScalar,      dotFloatScalar,  dotInt8Scalar,
+          logisticFloatScalar, hypertanFloatScalar, "scalar"};
+}
+
+const Dispatch &kernels() {
+  static const Dispatch dispatch = selectKernels();
+  return dispatch;
+}
+}  // namespace
+
+double Neuron::Kernels::dot(const double *a, const double *b, size_t size) {
+  return kernels().dot(a, b, size);
+}
+
+double Neuron::Kernels::gatherDot(const double *values,
+                                  const uint32_t *columns, size_t count,
+                                  const double *x) {
+  return kernels().gatherDot(values, columns, count, x);
+}
+
+void Neuron::Kernels::logistic(const double *in, double *out, size_t size,
+                               double beta, double theta) {
+  kernels().logistic(in, out, size, beta, theta);
+}
+
+void Neuron::Kernels::hypertan(const double *in, double *out, size_t size,
+                               double theta) {
+  kernels().hypertan(in, out, size, theta);
+}
+
+float Neuron::Kernels::dot(const float *a, const float *b, size_t size) {
+  return kernels().dotFloat(a, b, size);
+}
+
+int32_t Neuron::Kernels::dot(const int8_t *a, const int8_t *b, size_t size) {
+  return kernels().dotInt8(a, b, size);
+}
+
+void Neuron::Kernels::logistic(const float *in, float *out, size_t size,
+                               float beta, float theta) {
+  kernels().logisticFloat(in, out, size, beta, theta);
+}
+
+void Neuron::Kernels::hypertan(const float *in, float *out, size_t size,
+                               float theta) {
+  kernels().hypertanFloat(in, out, size, theta);
+}
+
+const char *Neuron::Kernels::instructionSet() { return kernels().name; }
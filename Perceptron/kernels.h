@@ -0,0 +1,31 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+#include <cstddef>
+#include <cstdint>
+// Vectorized building blocks for the neuron and network code. The widest
+// instruction set supported by the running CPU (AVX-512, AVX2 or plain
+// scalar code) is picked once on first use.
+namespace Neuron {
+namespace Kernels {
+double dot(const double *a, const double *b, size_t size);
+// sum of values[i] * x[columns[i]] for i < count, the row of a sparse matrix
+// times a dense vector
+double gatherDot(const double *values, const uint32_t *columns, size_t count,
+                 const double *x);
+// out[i] = 1 / (1 + exp(-beta * (in[i] - theta))), in and out may alias
+void logistic(const double *in, double *out, size_t size, double beta,
+              double theta);
+// out[i] = tanh(in[i] - theta), in and out may alias
+void hypertan(const double *in, double *out, size_t size, double theta);
+// single precision and int8 variants for the compact inference networks,
+// the int8 product accumulates in int32
+float dot(const float *a, const float *b, size_t size);
+int32_t dot(const int8_t *a, const int8_t *b, size_t size);
+void logistic(const float *in, float *out, size_t size, float beta,
+              float theta);
+void hypertan(const float *in, float *out, size_t size, float theta);
+// name of the instruction set the kernels dispatch to
+const char *instructionSet();
+}  // namespace Kernels
+}  // namespace Neuron
+#endif  // KERNELS_H
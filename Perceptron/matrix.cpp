@@ -0,0 +1,82 @@
+#include "matrix.h"
+
+#include <algorithm>
+
+#include "kernels.h"
+
+namespace {
+// Sized so that a block of each operand stays resident in L2 while the
+// inner loops stream over contiguous rows.
+constexpr size_t rowBlock = 64;
+constexpr size_t depthBlock = 256;
+}  // namespace
+
+void NeuralNetwork::multiplyTransposed(const Matrix &a, const Matrix &b,
+                                       Matrix &c) {
+  const size_t m = a.rows();
+  const size_t n = b.rows();
+  const size_t depth = a.cols();
+  c.resize(m, n);
+  std::fill(c.begin(), c.end(), 0.0);
+  for (size_t kk = 0; kk < depth; kk += depthBlock) {
+    const size_t k_end = std::min(kk + depthBlock, depth);
+    for (size_t ii = 0; ii < m; ii += rowBlock) {
+      const size_t i_end = std::min(ii + rowBlock, m);
+      for (size_t jj = 0; jj < n; jj += rowBlock) {
+        const size_t j_end = std::min(jj + rowBlock, n);
+        for (size_t i = ii; i < i_end; ++i) {
+          const double *a_row = a.row(i);
+          double *c_row = c.row(i);
+          for (size_t j = jj; j < j_end; ++j) {
+            const double *b_row = b.row(j);
+            c_row[j] += Neuron::Kernels::dot(a_row + kk, b_row + kk, k_end - kk);
+          }
+        }
+      }
+    }
+  }
+}
+
+void NeuralNetwork::multiplyLeftTransposed(const Matrix &a, const Matrix &b,
+                                           Matrix &c) {
+  const size_t m = a.cols();
+  const size_t n = b.cols();
+  const size_t depth = a.rows();
+  c.resize(m, n);
+  std::fill(c.begin(), c.end(), 0.0);
+  for (size_t kk = 0; kk < depth; kk += rowBlock) {
+    const size_t k_end = std::min(kk + rowBlock, depth);
+    for (size_t ii = 0; ii < m; ii += rowBlock) {
+      const size_t i_end = std::min(ii + rowBlock, m);
+      for (size_t k = kk; k < k_end; ++k) {
+        const double *a_row = a.row(k);
+        const double *b_row = b.row(k);
+        for (size_t i = ii; i < i_end; ++i) {
+          const double scale = a_row[i];
+          double *c_row = c.row(i);
+          for (size_t j = 0; j < n; ++j) c_row[j] += scale * b_row[j];
+        }
+      }
+    }
+  }
+}
+
+void NeuralNetwork::multiply(const Matrix &a, const Matrix &b, Matrix &c) {
+  const size_t m = a.rows();
+  const size_t n = b.cols();
+  const size_t depth = a.cols();
+  c.resize(m, n);
+  std::fill(c.begin(), c.end(), 0.0);
+  for (size_t kk = 0; kk < depth; kk += rowBlock) {
+    const size_t k_end = std::min(kk + rowBlock, depth);
+    for (size_t i = 0; i < m; ++i) {
+      const double *a_row = a.row(i);
+      double *c_row = c.row(i);
+      for (size_t k = kk; k < k_end; ++k) {
+        const double scale = a_row[k];
+        const double *b_row = b.row(k);
+        for (size_t j = 0; j < n; ++j) c_row[j] += scale * b_row[j];
+      }
+    }
+  }
+}
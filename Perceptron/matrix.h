@@ -0,0 +1,142 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+namespace NeuralNetwork {
+// Hands out blocks aligned to a cache line so that matrix rows can be fed
+// straight to vector loads. Over-allocates and stores the original pointer
+// in front of the block, which keeps it portable to pre C++17 toolchains.
+template <typename T, size_t Alignment = 64>
+struct AlignedAllocator {
+  using value_type = T;
+  template <typename U>
+  struct rebind {
+    using other = AlignedAllocator<U, Alignment>;
+  };
+
+  AlignedAllocator() = default;
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+  T *allocate(size_t n) {
+    void *raw = std::malloc(n * sizeof(T) + Alignment + sizeof(void *));
+    if (!raw) throw std::bad_alloc();
+    auto address = reinterpret_cast<uintptr_t>(raw) + sizeof(void *);
+    address = (address + Alignment - 1) & ~(uintptr_t{Alignment} - 1);
+    reinterpret_cast<void **>(address)[-1] = raw;
+    return reinterpret_cast<T *>(address);
+  }
+
+  void deallocate(T *block, size_t) {
+    if (block) std::free(reinterpret_cast<void **>(block)[-1]);
+  }
+};
+
+template <typename T, typename U, size_t Alignment>
+bool operator==(const AlignedAllocator<T, Alignment> &,
+                const AlignedAllocator<U, Alignment> &) {
+  return true;
+}
+
+template <typename T, typename U, size_t Alignment>
+bool operator!=(const AlignedAllocator<T, Alignment> &,
+                const AlignedAllocator<U, Alignment> &) {
+  return false;
+}
+
+// Dense row-major matrix kept in a single aligned allocation. A matrix can
+// also view memory owned elsewhere, e.g. a mapped model file, in which case
+// the owner handle keeps that memory alive. Copies and resizes of a view
+// detach into owned storage.
+class Matrix {
+ public:
+  Matrix() = default;
+  Matrix(size_t rows, size_t cols, double value = 0.0)
+      : row_count(rows),
+        col_count(cols),
+        values(rows * cols, value),
+        pointer(values.data()) {}
+  Matrix(const Matrix &other)
+      : row_count(other.row_count),
+        col_count(other.col_count),
+        values(other.begin(), other.end()),
+        pointer(values.data()) {}
+  Matrix(Matrix &&other) noexcept { swap(other); }
+  Matrix &operator=(Matrix other) noexcept {
+    swap(other);
+    return *this;
+  }
+
+  static Matrix view(double *data, size_t rows, size_t cols,
+                     std::shared_ptr<void> owner) {
+    Matrix matrix;
+    matrix.row_count = rows;
+    matrix.col_count = cols;
+    matrix.pointer = data;
+    matrix.owner = std::move(owner);
+    return matrix;
+  }
+
+  void swap(Matrix &other) noexcept {
+    std::swap(row_count, other.row_count);
+    std::swap(col_count, other.col_count);
+    values.swap(other.values);
+    std::swap(pointer, other.pointer);
+    owner.swap(other.owner);
+  }
+
+  void resize(size_t rows, size_t cols) {
+    if (owner) {
+      values.assign(pointer, pointer + std::min(size(), rows * cols));
+      owner.reset();
+    }
+    row_count = rows;
+    col_count = cols;
+    values.resize(rows * cols);
+    pointer = values.data();
+  }
+
+  bool isView() const { return owner != nullptr; }
+  size_t rows() const { return row_count; }
+  size_t cols() const { return col_count; }
+  size_t size() const { return row_count * col_count; }
+
+  double *data() { return pointer; }
+  const double *data() const { return pointer; }
+  double *row(size_t r) { return pointer + r * col_count; }
+  const double *row(size_t r) const { return pointer + r * col_count; }
+
+  double &operator()(size_t r, size_t c) { return pointer[r * col_count + c]; }
+  double operator()(size_t r, size_t c) const {
+    return pointer[r * col_count + c];
+  }
+
+  double *begin() { return pointer; }
+  double *end() { return pointer + size(); }
+  const double *begin() const { return pointer; }
+  const double *end() const { return pointer + size(); }
+
+ private:
+  size_t row_count{0};
+  size_t col_count{0};
+  std::vector<double, AlignedAllocator<double>> values;
+  double *pointer{nullptr};
+  std::shared_ptr<void> owner;
+};
+
+// Cache blocked products used by the batched training path. The result is
+// resized to fit and overwritten.
+// c = a * b^T, a is m x k and b is n x k
+void multiplyTransposed(const Matrix &a, const Matrix &b, Matrix &c);
+// c = a^T * b, a is k x m and b is k x n
+void multiplyLeftTransposed(const Matrix &a, const Matrix &b, Matrix &c);
+// c = a * b, a is m x k and b is k x n
+void multiply(const Matrix &a, const Matrix &b, Matrix &c);
+}  // namespace NeuralNetwork
+#endif  // MATRIX_H
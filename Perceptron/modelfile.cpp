@@ -0,0 +1,189 @@
+#include "modelfile.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MODELFILE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr char magic[8] = {'N', 'N', 'M', 'O', 'D', 'E', 'L', '\0'};
+constexpr uint32_t byteOrder = 0x01020304;
+constexpr uint64_t blockAlignment = 64;
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t activation;
+  uint32_t reserved0;
+  double theta;
+  double beta;
+  uint64_t layer_count;
+  uint64_t reserved[2];
+};
+static_assert(sizeof(FileHeader) == 64, "model header must stay 64 bytes");
+
+struct LayerEntry {
+  uint64_t rows;
+  uint64_t cols;
+  uint64_t offset;
+  uint64_t reserved;
+};
+static_assert(sizeof(LayerEntry) == 32, "layer entry must stay 32 bytes");
+
+uint64_t alignBlock(uint64_t offset) {
+  return (offset + blockAlignment - 1) / blockAlignment * blockAlignment;
+}
+
+struct MappedFile {
+  std::shared_ptr<void> owner;
+  char *data{nullptr};
+  size_t size{0};
+};
+
+MappedFile mapFile(const std::string &path) {
+  MappedFile file;
+#ifdef MODELFILE_MMAP
+  int descriptor = ::open(path.c_str(), O_RDONLY);
+  if (descriptor < 0) {
+    throw std::runtime_error("cannot open model file " + path);
+  }
+  struct stat info;
+  if (::fstat(descriptor, &info) != 0 || info.st_size <= 0) {
+    ::close(descriptor);
+    throw std::runtime_error("cannot read model file " + path);
+  }
+  const size_t size = static_cast<size_t>(info.st_size);
+  // private writable mapping, pages are copied only once training touches
+  // them and the file itself is never written
+  void *address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                         descriptor, 0);
+  ::close(descriptor);
+  if (address == MAP_FAILED) {
+    throw std::runtime_error("cannot map model file " + path);
+  }
+  file.owner = std::shared_ptr<void>(
+      address, [size](void *mapped) { ::munmap(mapped, size); });
+  file.data = static_cast<char *>(address);
+  file.size = size;
+#else
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
+  if (!in) throw std::runtime_error("cannot open model file " + path);
+  const auto size = static_cast<size_t>(in.tellg());
+  auto buffer = std::make_shared<
+      std::vector<char, NeuralNetwork::AlignedAllocator<char>>>(size);
+  in.seekg(0);
+  if (!in.read(buffer->data(), static_cast<std::streamsize>(size))) {
+    throw std::runtime_error("cannot read model file " + path);
+  }
+  file.data = buffer->data();
+  file.size = size;
+  file.owner = std::move(buffer);
+#endif
+  return file;
+}
+}  // namespace
+
+void NeuralNetwork::ModelFile::save(const NeuralNetwork &network,
+                                    const std::string &path) {
+  if (network.activation == Neuron::Activation::Custom) {
+    throw std::runtime_error("networks with a custom activation cannot be saved");
+  }
+  FileHeader header{};
+  std::memcpy(header.magic, magic, sizeof(magic));
+  header.version = version;
+  header.byte_order = byteOrder;
+  header.activation = static_cast<uint32_t>(network.activation);
+  header.theta = network.parameters.theta;
+  header.beta = network.parameters.beta;
+  header.layer_count = network.layers.size();
+
+  std::vector<LayerEntry> entries;
+  uint64_t offset = alignBlock(sizeof(FileHeader) +
+                               network.layers.size() * sizeof(LayerEntry));
+  for (const auto &layer : network.layers) {
+    LayerEntry entry{};
+    entry.rows = layer.weights.rows();
+    entry.cols = layer.weights.cols();
+    entry.offset = offset;
+    entries.push_back(entry);
+    offset = alignBlock(offset + layer.weights.size() * sizeof(double));
+  }
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) throw std::runtime_error("cannot create model file " + path);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(entries.data()),
+            static_cast<std::streamsize>(entries.size() * sizeof(LayerEntry)));
+  uint64_t written = sizeof(header) + entries.size() * sizeof(LayerEntry);
+  const char padding[blockAlignment] = {};
+  for (size_t l = 0; l < entries.size(); ++l) {
+    out.write(padding, static_cast<std::streamsize>(entries[l].offset - written));
+    const Matrix &weights = network.layers[l].weights;
+    out.write(reinterpret_cast<const char *>(weights.data()),
+              static_cast<std::streamsize>(weights.size() * sizeof(double)));
+    written = entries[l].offset + weights.size() * sizeof(double);
+  }
+  out.flush();
+  if (!out) throw std::runtime_error("cannot write model file " + path);
+}
+
+std::unique_ptr<NeuralNetwork::NeuralNetwork> NeuralNetwork::ModelFile::load(
+    const std::string &path) {
+  MappedFile file = mapFile(path);
+  auto invalid = [&path](const char *reason) {
+    return std::runtime_error("invalid model file " + path + ": " + reason);
+  };
+  if (file.size < sizeof(FileHeader)) throw invalid("truncated header");
+  FileHeader header;
+  std::memcpy(&header, file.data, sizeof(header));
+  if (std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+    throw invalid("bad magic");
+  }
+  if (header.byte_order != byteOrder) throw invalid("foreign byte order");
+  if (header.version != version) throw invalid("unsupported version");
+  if (header.activation >= static_cast<uint32_t>(Neuron::Activation::Custom)) {
+    throw invalid("unknown activation");
+  }
+  if (!header.layer_count ||
+      header.layer_count > (file.size - sizeof(FileHeader)) / sizeof(LayerEntry)) {
+    throw invalid("bad layer count");
+  }
+
+  auto network = std::make_unique<NeuralNetwork>();
+  network->layers.resize(header.layer_count);
+  for (size_t l = 0; l < header.layer_count; ++l) {
+    LayerEntry entry;
+    std::memcpy(&entry, file.data + sizeof(FileHeader) + l * sizeof(LayerEntry),
+                sizeof(entry));
+    if (!entry.rows || !entry.cols ||
+        entry.cols > file.size / sizeof(double) / entry.rows ||
+        entry.offset % blockAlignment || entry.offset > file.size ||
+        entry.rows * entry.cols * sizeof(double) > file.size - entry.offset) {
+      throw invalid("bad layer entry");
+    }
+    if (l && entry.cols != network->layers[l - 1].weights.rows()) {
+      throw invalid("layer sizes do not chain");
+    }
+    auto &layer = network->layers[l];
+    layer.neurons.assign(entry.rows, 0);
+    layer.sums.assign(entry.rows, 0);
+    layer.weights = Matrix::view(
+        reinterpret_cast<double *>(file.data + entry.offset), entry.rows,
+        entry.cols, file.owner);
+  }
+  network->activation = static_cast<Neuron::Activation>(header.activation);
+  network->parameters.theta = header.theta;
+  network->parameters.beta = header.beta;
+  // a pruned model runs its sparse layers compressed again
+  network->compressLayers();
+  return network;
+}
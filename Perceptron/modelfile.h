@@ -0,0 +1,27 @@
+#ifndef MODELFILE_H
+#define MODELFILE_H
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "network.h"
+namespace NeuralNetwork {
+// Versioned binary model format. A 64 byte header holding the magic, format
+// version, activation, theta and beta is followed by one 32 byte entry per
+// layer (rows, columns, offset) and the row-major weight blocks, each one
+// starting on a 64 byte boundary. Values are stored in native byte order,
+// a marker in the header rejects files written on a foreign endianness.
+//
+// load() maps the file copy-on-write and the network uses the weights in
+// place, training a loaded network never modifies the file. Networks with a
+// custom activation cannot be saved. Pruned weights are stored as zeros and
+// their masks are dropped, see NeuralNetwork::prune. Errors are reported as
+// std::runtime_error.
+class ModelFile {
+ public:
+  static constexpr uint32_t version = 1;
+
+  static void save(const NeuralNetwork &network, const std::string &path);
+  static std::unique_ptr<NeuralNetwork> load(const std::string &path);
+};
+}  // namespace NeuralNetwork
+#endif  // MODELFILE_H
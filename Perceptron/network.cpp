@@ -1,92 +1,793 @@
 #include "network.h"
 
+#include "profiler.h"
+#include <stdexcept>
 #include <utility>
+
+namespace {
+// whether the strongest output is the expected class, a single output is
+// read as a yes/no answer instead
+bool classifiedCorrectly(const double *result, const double *expected,
+                         size_t count) {
+  if (count == 1) return std::abs(expected[0] - result[0]) < 0.5;
+  return std::max_element(result, result + count) - result ==
+         std::max_element(expected, expected + count) - expected;
+}
+
+// samples per predictBatch call when measuring the validation loss
+constexpr size_t validationBatch = 256;
+
+// state of the optimizer for one row of weights, null if it keeps none
+double *stateRow(NeuralNetwork::Matrix &state, size_t row) {
+  return state.size() ? state.row(row) : nullptr;
+}
+
+// vectors of samples seen through the interface of a SampleView
+struct VectorSamples {
+  std::vector<std::vector<double>> &inputs;
+  std::vector<std::vector<double>> &outputs;
+  size_t size() const { return std::min(inputs.size(), outputs.size()); }
+  const double *input(size_t i) const { return inputs[i].data(); }
+  const double *output(size_t i) const { return outputs[i].data(); }
+  void beginEpoch() {}
+};
+
+// what a checkpoint keeps of the samples, only views have an order and a
+// shuffle engine of their own
+template <typename Samples>
+void captureSamples(const Samples &, NeuralNetwork::TrainingState &state) {
+  state.sample_order.clear();
+  state.sample_engine.clear();
+}
+
+void captureSamples(const NeuralNetwork::SampleView &samples,
+                    NeuralNetwork::TrainingState &state) {
+  state.sample_order.assign(samples.order().begin(), samples.order().end());
+  state.sample_engine = samples.engineState();
+}
+
+#ifdef NEURALNETWORK_PROFILING
+// weights a product with the layer reads, the compressed ones if it has them
+size_t usedWeights(const NeuralNetwork::Matrix &weights,
+                   const NeuralNetwork::SparseMatrix &sparse) {
+  return sparse.empty() ? weights.size() : sparse.nonZeros();
+}
+#endif
+
+// keeps pruned weights at zero after an update
+void applyMask(const double *mask, double *weights, size_t count) {
+  for (size_t k = 0; k < count; ++k) weights[k] *= mask[k];
+}
+
+// copies into the storage target already holds
+void copyMatrix(const NeuralNetwork::Matrix &source,
+                NeuralNetwork::Matrix &target) {
+  target.resize(source.rows(), source.cols());
+  std::copy(source.begin(), source.end(), target.begin());
+}
+}  // namespace
 std::vector<double> NeuralNetwork::NeuralNetwork::simulate(
     std::vector<double> &input) {
-  for (auto it = std::begin(layers); it != std::end(layers); ++it) {
-    if (it == std::begin(layers)) {
-      for (size_t i = 0; i < (*it).neurons.size(); ++i) {
-        (*it).neurons.at(i) =
-            Neuron::neuron(input, (*it).weights.at(i), neuron);
+  forward(input.data());
+  return layers.back().neurons;
+}
+
+void NeuralNetwork::NeuralNetwork::simulate(const double *input,
+                                            double *output) {
+  forward(input);
+  std::copy(layers.back().neurons.begin(), layers.back().neurons.end(),
+            output);
+}
+
+NeuralNetwork::Matrix NeuralNetwork::NeuralNetwork::predictBatch(
+    const Matrix &inputs) const {
+  Matrix outputs;
+  predictBatch(inputs, outputs);
+  return outputs;
+}
+
+void NeuralNetwork::NeuralNetwork::predictBatch(const Matrix &inputs,
+                                                Matrix &outputs) const {
+  if (inputs.cols() != inputCount()) {
+    throw std::invalid_argument("inputs do not match the network");
+  }
+  // ping-pong buffers for the hidden layers, grown once per thread
+  thread_local Matrix scratch[2];
+  withActivation([&](auto policy) {
+    const Matrix *previous = &inputs;
+    for (size_t l = 0; l < layers.size(); ++l) {
+      const SparseMatrix &sparse = layers[l].sparse;
+      NN_PROFILE_SCOPE("predict", static_cast<int>(l),
+                       2 * inputs.rows() *
+                           usedWeights(layers[l].weights, sparse),
+                       (inputs.rows() * (layers[l].weights.cols() +
+                                         layers[l].weights.rows()) +
+                        usedWeights(layers[l].weights, sparse)) *
+                           sizeof(double));
+      Matrix &target = (l + 1 == layers.size()) ? outputs : scratch[l % 2];
+      if (sparse.empty()) {
+        multiplyTransposed(*previous, layers[l].weights, target);
+      } else {
+        sparse.multiplyTransposed(*previous, target);
       }
-    } else {
-      for (size_t i = 0; i < (*it).neurons.size(); ++i) {
-        (*it).neurons.at(i) =
-            Neuron::neuron((*(it - 1)).neurons, (*it).weights.at(i), neuron);
+      policy.activate(target.data(), target.data(), target.size());
+      previous = &target;
+    }
+  });
+}
+
+size_t NeuralNetwork::NeuralNetwork::inputCount() const {
+  return layers.empty() ? 0 : layers.front().weights.cols();
+}
+
+size_t NeuralNetwork::NeuralNetwork::outputCount() const {
+  return layers.empty() ? 0 : layers.back().neurons.size();
+}
+
+size_t NeuralNetwork::NeuralNetwork::layerCount() const {
+  return layers.size();
+}
+
+const NeuralNetwork::Matrix &NeuralNetwork::NeuralNetwork::layerWeights(
+    size_t layer) const {
+  return layers.at(layer).weights;
+}
+
+bool NeuralNetwork::NeuralNetwork::layerIsSparse(size_t layer) const {
+  return !layers.at(layer).sparse.empty();
+}
+
+Neuron::Activation NeuralNetwork::NeuralNetwork::activationFunction() const {
+  return activation;
+}
+
+const Neuron::ActivationParameters &
+NeuralNetwork::NeuralNetwork::activationParameters() const {
+  return parameters;
+}
+
+void NeuralNetwork::NeuralNetwork::forward(const double *input) {
+  withActivation([this, input](auto policy) {
+    const double *inputs = input;
+    for (auto &layer : layers) {
+      const size_t fan_in = layer.weights.cols();
+      NN_PROFILE_SCOPE("forward", static_cast<int>(&layer - layers.data()),
+                       2 * usedWeights(layer.weights, layer.sparse),
+                       (usedWeights(layer.weights, layer.sparse) + fan_in +
+                        2 * layer.sums.size()) *
+                           sizeof(double));
+      if (!layer.sparse.empty()) {
+        layer.sparse.multiply(inputs, layer.sums.data());
+      } else {
+        for (size_t i = 0; i < layer.neurons.size(); ++i) {
+          layer.sums[i] =
+              Neuron::Kernels::dot(inputs, layer.weights.row(i), fan_in);
+        }
       }
+      policy.activate(layer.sums.data(), layer.neurons.data(),
+                      layer.neurons.size());
+      inputs = layer.neurons.data();
     }
-  }
-  return (*(std::end(layers) - 1)).neurons;
+  });
 }
 
 double NeuralNetwork::NeuralNetwork::test(
     std::vector<double> &input, std::vector<double> &output) {
-  auto result = this->simulate(input);
-  std::vector<double> deviations;
-  deviations.reserve(result.size());
-  std::transform(std::begin(result), std::end(result), std::begin(output), std::back_inserter(deviations),
-                 [](auto actual, auto desired){return (desired-actual)/(desired ? desired : 1);});
-  double err = std::accumulate(std::begin(deviations), std::end(deviations), 0.0)/static_cast<double>(deviations.size());
-  return std::abs(err);
+  return test(input.data(), output.data());
 }
 
-void NeuralNetwork::NeuralNetwork::train(
-        std::vector<std::vector<double>> &input, std::vector<std::vector<double>> &output, double eta,
-        double epsilon, size_t max_iterations) {
-    for (size_t j = 0; j < max_iterations; ++j) {
-        auto in_it = std::begin(input);
-        auto out_it = std::begin(output);
-        while(in_it != std::end(input) || out_it != std::end(output)){
-            auto result = this->simulate(*in_it);
-            std::vector<double> output_error;
-            std::transform(std::begin(*out_it), std::end(*out_it), std::begin(result),
-                           std::back_inserter(output_error), std::minus<>());
-            auto max_error = *std::max_element(
-                        std::begin(output_error), std::end(output_error),
-                        [](auto a, auto b) { return (std::abs(a) < std::abs(b)); });
-            if (std::abs(max_error) < epsilon) break;
-            for (auto it = std::rbegin(layers); it != std::rend(layers); ++it) {
-                std::vector<double> &inputs =
-                        (it == std::rend(layers) - 1) ? *in_it : (it + 1)->neurons;
-                auto &weights = (*it).weights;
-
-                std::vector<double> state_derivative;
-                for (size_t i = 0; i < it->neurons.size(); ++i) {
-                    state_derivative.push_back(
-                                Neuron::neuron(inputs, weights.at(i), neuronDerivative));
+double NeuralNetwork::NeuralNetwork::test(const double *input,
+                                          const double *output) {
+  forward(input);
+  const auto &result = layers.back().neurons;
+  double squared_error = 0.0;
+  for (size_t i = 0; i < result.size(); ++i) {
+    const double error = output[i] - result[i];
+    squared_error += error * error;
+  }
+  return squared_error / static_cast<double>(result.size());
+}
+
+void NeuralNetwork::NeuralNetwork::setThreadCount(size_t threads) {
+  pool = threads > 1 ? std::make_unique<ThreadPool>(threads) : nullptr;
+}
+
+size_t NeuralNetwork::NeuralNetwork::threadCount() const {
+  return pool ? pool->size() : 1;
+}
+
+void NeuralNetwork::NeuralNetwork::setOptimizer(const Optimizer &optimizer) {
+  this->optimizer = optimizer;
+  const size_t states = optimizer.stateCount();
+  for (auto &layer : layers) {
+    const size_t rows = layer.weights.rows();
+    const size_t cols = layer.weights.cols();
+    layer.first_moment.resize(states > 0 ? rows : 0, cols);
+    layer.second_moment.resize(states > 1 ? rows : 0, cols);
+    std::fill(layer.first_moment.begin(), layer.first_moment.end(), 0.0);
+    std::fill(layer.second_moment.begin(), layer.second_moment.end(), 0.0);
+  }
+  optimizer_steps = 0;
+}
+
+const NeuralNetwork::Optimizer &
+NeuralNetwork::NeuralNetwork::optimizerSettings() const {
+  return optimizer;
+}
+
+void NeuralNetwork::NeuralNetwork::setEarlyStopping(
+    SampleView validation, const EarlyStopping &stopping) {
+  if (validation.inputCount() != inputCount() ||
+      validation.outputCount() != outputCount()) {
+    throw std::invalid_argument("validation samples do not match the network");
+  }
+  this->validation = std::move(validation);
+  early_stopping = stopping;
+}
+
+void NeuralNetwork::NeuralNetwork::clearEarlyStopping() {
+  validation = SampleView();
+}
+
+void NeuralNetwork::NeuralNetwork::setCheckpoints(
+    std::shared_ptr<CheckpointWriter> writer) {
+  if (activation == Neuron::Activation::Custom) {
+    throw std::invalid_argument(
+        "networks with a custom activation cannot be checkpointed");
+  }
+  checkpoints = std::move(writer);
+}
+
+// a checkpoint still being written is finished by its writer
+void NeuralNetwork::NeuralNetwork::clearCheckpoints() { checkpoints.reset(); }
+
+// Every layer gets a mask on its first pruning. The sparsity rule removes
+// exactly its share of a layer, ties at the cut-off magnitude go in storage
+// order.
+double NeuralNetwork::NeuralNetwork::prune(const Pruning &pruning) {
+  if (!(pruning.threshold >= 0.0) ||
+      !(pruning.sparsity >= 0.0 && pruning.sparsity < 1.0)) {
+    throw std::invalid_argument(
+        "pruning needs a threshold >= 0 and a sparsity in [0, 1)");
+  }
+  std::vector<double> magnitudes;
+  size_t pruned = 0;
+  size_t total = 0;
+  for (auto &layer : layers) {
+    Matrix &weights = layer.weights;
+    if (!layer.mask.size()) {
+      layer.mask = Matrix(weights.rows(), weights.cols(), 1.0);
+    }
+    double cutoff = pruning.threshold;
+    // weights at exactly the cut-off that are pruned as well
+    size_t ties = 0;
+    const auto target = static_cast<size_t>(
+        pruning.sparsity * static_cast<double>(weights.size()));
+    if (target) {
+      magnitudes.resize(weights.size());
+      std::transform(weights.begin(), weights.end(), magnitudes.begin(),
+                     [](double weight) { return std::abs(weight); });
+      const auto last = magnitudes.begin() + (target - 1);
+      std::nth_element(magnitudes.begin(), last, magnitudes.end());
+      if (*last >= cutoff) {
+        cutoff = *last;
+        ties = target - static_cast<size_t>(std::count_if(
+                            magnitudes.begin(), last,
+                            [cutoff](double m) { return m < cutoff; }));
+      }
+    }
+    double *values = weights.begin();
+    double *mask = layer.mask.begin();
+    for (size_t k = 0; k < weights.size(); ++k) {
+      const double magnitude = std::abs(values[k]);
+      if (magnitude < cutoff) {
+        mask[k] = 0.0;
+      } else if (magnitude == cutoff && ties) {
+        mask[k] = 0.0;
+        --ties;
+      }
+      values[k] *= mask[k];
+    }
+    pruned += static_cast<size_t>(
+        std::count(layer.mask.begin(), layer.mask.end(), 0.0));
+    total += weights.size();
+  }
+  compressLayers();
+  return total ? static_cast<double>(pruned) / static_cast<double>(total)
+               : 0.0;
+}
+
+void NeuralNetwork::NeuralNetwork::clearPruning() {
+  for (auto &layer : layers) layer.mask = Matrix();
+}
+
+// Runs the forward and backward pass for the batch in state as matrix
+// products, caching the summed inputs and activations of every layer. The
+// gradients summed over the batch are left in state, the weights are not
+// touched so shards of one batch can run concurrently.
+void NeuralNetwork::NeuralNetwork::backpropagate(BatchState &state) const {
+  const size_t count = state.input.rows();
+  state.sums.resize(layers.size());
+  state.activations.resize(layers.size());
+  state.deltas.resize(layers.size());
+  state.gradients.resize(layers.size());
+
+  for (size_t l = 0; l < layers.size(); ++l) {
+    const Matrix &previous = l ? state.activations[l - 1] : state.input;
+    NN_PROFILE_SCOPE("forward", static_cast<int>(l),
+                     2 * count * layers[l].weights.size(),
+                     (previous.size() + layers[l].weights.size() +
+                      2 * count * layers[l].weights.rows()) *
+                         sizeof(double));
+    multiplyTransposed(previous, layers[l].weights, state.sums[l]);
+    state.activations[l].resize(count, state.sums[l].cols());
+    withActivation([&](auto policy) {
+      policy.activate(state.sums[l].data(), state.activations[l].data(),
+                      state.sums[l].size());
+    });
+  }
+
+  const Matrix &result = state.activations.back();
+  Matrix &output_delta = state.deltas.back();
+  output_delta.resize(count, result.cols());
+  state.squared_error = 0.0;
+  state.max_error = withActivation([&](auto policy) {
+    double max_error = 0.0;
+    for (size_t i = 0; i < result.size(); ++i) {
+      const double error = state.output.data()[i] - result.data()[i];
+      max_error = std::max(max_error, std::abs(error));
+      state.squared_error += error * error;
+      output_delta.data()[i] =
+          error * policy.derivative(state.sums.back().data()[i]);
+    }
+    return max_error;
+  });
+  state.correct = 0;
+  for (size_t r = 0; r < count; ++r) {
+    state.correct += classifiedCorrectly(result.row(r), state.output.row(r),
+                                         result.cols());
+  }
+
+  for (size_t l = layers.size(); l-- > 0;) {
+    NN_PROFILE_SCOPE("backward", static_cast<int>(l),
+                     (l ? 4 : 2) * count * layers[l].weights.size(),
+                     (2 * layers[l].weights.size() +
+                      (l ? 3 : 1) * count * layers[l].weights.cols() +
+                      count * layers[l].weights.rows()) *
+                         sizeof(double));
+    if (l) {
+      Matrix &delta = state.deltas[l - 1];
+      multiply(state.deltas[l], layers[l].weights, delta);
+      withActivation([&](auto policy) {
+        std::transform(delta.begin(), delta.end(), state.sums[l - 1].begin(),
+                       delta.begin(), [&policy](double delta, double sum) {
+                         return delta * policy.derivative(sum);
+                       });
+      });
+    }
+    const Matrix &previous = l ? state.activations[l - 1] : state.input;
+    multiplyLeftTransposed(state.deltas[l], previous, state.gradients[l]);
+  }
+}
+
+// One gradient step over count samples. The batch is split into one shard
+// per thread, fill(begin, end, state) copies the samples [begin, end) of the
+// batch into the shard, which computes its gradients on private buffers. The
+// shard gradients are then summed pairwise in a tree and applied in a single
+// update. Returns false without touching the weights once every output is
+// within epsilon.
+template <typename Fill>
+bool NeuralNetwork::NeuralNetwork::descend(size_t count, double eta,
+                                           double epsilon, Fill &&fill,
+                                           EpochTotals &totals) {
+  auto &shards = workspace.shards;
+  shards.resize(threadCount());
+  const size_t shard_count = std::min(shards.size(), count);
+  parallel(shard_count, [&](size_t s) {
+    BatchState &state = shards[s];
+    fill(count * s / shard_count, count * (s + 1) / shard_count, state);
+    backpropagate(state);
+  });
+
+  double max_error = 0.0;
+  for (size_t s = 0; s < shard_count; ++s) {
+    max_error = std::max(max_error, shards[s].max_error);
+    totals.squared_error += shards[s].squared_error;
+    totals.correct += shards[s].correct;
+  }
+  totals.seen += count;
+  if (max_error < epsilon) return false;
+
+  for (size_t stride = 1; stride < shard_count; stride *= 2) {
+    parallel((shard_count + 2 * stride - 1) / (2 * stride), [&](size_t p) {
+      const size_t target = p * 2 * stride;
+      if (target + stride >= shard_count) return;
+      for (size_t l = 0; l < layers.size(); ++l) {
+        Matrix &sum = shards[target].gradients[l];
+        const Matrix &other = shards[target + stride].gradients[l];
+        NN_PROFILE_SCOPE("reduce", static_cast<int>(l), sum.size(),
+                         3 * sum.size() * sizeof(double));
+        std::transform(sum.begin(), sum.end(), other.begin(), sum.begin(),
+                       std::plus<>());
+      }
+    });
+  }
+
+  totals.converged = false;
+  const Optimizer::Step step = optimizer.step(eta, ++optimizer_steps);
+  const double scale = 1.0 / static_cast<double>(count);
+  for (size_t l = 0; l < layers.size(); ++l) {
+    const double *gradient = shards.front().gradients[l].begin();
+    NetworkLayer &layer = layers[l];
+    NN_PROFILE_SCOPE("update", static_cast<int>(l),
+                     (2 + 3 * optimizer.stateCount()) * layer.weights.size(),
+                     (3 + 2 * optimizer.stateCount()) * layer.weights.size() *
+                         sizeof(double));
+    optimizer.update(step, layer.weights.begin(), layer.first_moment.begin(),
+                     layer.second_moment.begin(), layer.weights.size(),
+                     [gradient, scale](size_t k) { return gradient[k] * scale; });
+    if (layer.mask.size()) {
+      applyMask(layer.mask.begin(), layer.weights.begin(),
+                layer.weights.size());
+    }
+  }
+  return true;
+}
+
+// the optimizer state of networks built or loaded since the last
+// setOptimizer() is created here
+size_t NeuralNetwork::NeuralNetwork::beginTraining() {
+  const size_t states = optimizer.stateCount();
+  if (std::any_of(layers.begin(), layers.end(),
+                  [states](const NetworkLayer &layer) {
+                    const size_t size = layer.weights.size();
+                    return layer.first_moment.size() != (states > 0 ? size : 0) ||
+                           layer.second_moment.size() != (states > 1 ? size : 0);
+                  })) {
+    setOptimizer(optimizer);
+  }
+  // the weights change from here on, endTraining() compresses them again
+  for (auto &layer : layers) layer.sparse.clear();
+  workspace.best_weights.clear();
+  workspace.best_loss = std::numeric_limits<double>::infinity();
+  workspace.stale_epochs = 0;
+  if (!resumed) return 0;
+  workspace.best_weights = std::move(resumed->best_weights);
+  workspace.best_loss = resumed->best_loss;
+  workspace.stale_epochs = resumed->stale_epochs;
+  const size_t first_epoch = resumed->epoch;
+  resumed.reset();
+  return first_epoch;
+}
+
+// Only copies into the spare state of the writer, which keeps its storage
+// from one checkpoint to the next.
+template <typename Samples>
+void NeuralNetwork::NeuralNetwork::checkpoint(size_t epoch, size_t epochs,
+                                              const Samples &samples) {
+  if (!checkpoints) return;
+  TrainingState *state = checkpoints->acquire(epoch);
+  if (!state) return;
+  captureState(epoch, epochs, *state);
+  captureSamples(samples, *state);
+  checkpoints->submit();
+}
+
+void NeuralNetwork::NeuralNetwork::captureState(size_t epoch, size_t epochs,
+                                                TrainingState &state) const {
+  state.epoch = epoch;
+  state.epochs = epochs;
+  state.activation = activation;
+  state.parameters = parameters;
+  state.optimizer = optimizer;
+  state.optimizer_steps = optimizer_steps;
+  const size_t states = optimizer.stateCount();
+  state.weights.resize(layers.size());
+  state.first_moments.resize(states > 0 ? layers.size() : 0);
+  state.second_moments.resize(states > 1 ? layers.size() : 0);
+  state.masks.resize(layers.front().mask.size() ? layers.size() : 0);
+  for (size_t l = 0; l < layers.size(); ++l) {
+    copyMatrix(layers[l].weights, state.weights[l]);
+    if (states > 0) copyMatrix(layers[l].first_moment, state.first_moments[l]);
+    if (states > 1) {
+      copyMatrix(layers[l].second_moment, state.second_moments[l]);
+    }
+    if (!state.masks.empty()) copyMatrix(layers[l].mask, state.masks[l]);
+  }
+  state.best_loss = workspace.best_loss;
+  state.stale_epochs = workspace.stale_epochs;
+  state.best_weights.resize(workspace.best_weights.size());
+  for (size_t l = 0; l < workspace.best_weights.size(); ++l) {
+    copyMatrix(workspace.best_weights[l], state.best_weights[l]);
+  }
+}
+
+// Measures the validation loss and keeps the weights of the best epoch. The
+// training stops once the callback asks for it, every sample was within
+// epsilon or the validation loss stalled for the patience of early stopping.
+bool NeuralNetwork::NeuralNetwork::endEpoch(size_t epoch, size_t epochs,
+                                            const EpochTotals &totals,
+                                            const EpochCallback &on_epoch) {
+  bool improving = true;
+  EpochReport report{epoch, epochs, 0.0, 0.0};
+  if (!validation.empty()) {
+    report.validation_loss = validationLoss();
+    if (report.validation_loss <
+        workspace.best_loss - early_stopping.min_improvement) {
+      workspace.best_loss = report.validation_loss;
+      workspace.stale_epochs = 0;
+      if (early_stopping.restore_best) {
+        workspace.best_weights.resize(layers.size());
+        for (size_t l = 0; l < layers.size(); ++l) {
+          workspace.best_weights[l].resize(layers[l].weights.rows(),
+                                           layers[l].weights.cols());
+          std::copy(layers[l].weights.begin(), layers[l].weights.end(),
+                    workspace.best_weights[l].begin());
+        }
+      }
+    } else {
+      improving = ++workspace.stale_epochs < early_stopping.patience;
+    }
+  }
+  if (on_epoch) {
+    const double count = static_cast<double>(std::max<size_t>(totals.seen, 1));
+    report.loss = totals.squared_error /
+                  (count * static_cast<double>(outputCount()));
+    report.accuracy = static_cast<double>(totals.correct) / count;
+    if (!on_epoch(report)) return false;
+  }
+  return improving && !totals.converged;
+}
+
+void NeuralNetwork::NeuralNetwork::endTraining() {
+  for (size_t l = 0; l < workspace.best_weights.size(); ++l) {
+    layers[l].weights.swap(workspace.best_weights[l]);
+  }
+  workspace.best_weights.clear();
+  compressLayers();
+}
+
+void NeuralNetwork::NeuralNetwork::compressLayers() {
+  for (auto &layer : layers) {
+    if (SparseMatrix::density(layer.weights) <= SparseMatrix::maxDensity) {
+      layer.sparse.assign(layer.weights);
+    } else {
+      layer.sparse.clear();
+    }
+  }
+}
+
+// mean squared error on the validation samples, predicted in batches spread
+// over the pool
+double NeuralNetwork::NeuralNetwork::validationLoss() {
+  const size_t count = validation.size();
+  const size_t input_count = inputCount();
+  const size_t output_count = outputCount();
+  auto &shards = workspace.shards;
+  shards.resize(threadCount());
+  const size_t shard_count = std::min(shards.size(), count);
+  parallel(shard_count, [&](size_t s) {
+    BatchState &state = shards[s];
+    state.squared_error = 0.0;
+    const size_t end = count * (s + 1) / shard_count;
+    for (size_t first = count * s / shard_count; first < end;
+         first += validationBatch) {
+      const size_t rows = std::min(validationBatch, end - first);
+      state.input.resize(rows, input_count);
+      for (size_t r = 0; r < rows; ++r) {
+        std::copy_n(validation.input(first + r), input_count,
+                    state.input.row(r));
+      }
+      predictBatch(state.input, state.prediction);
+      for (size_t r = 0; r < rows; ++r) {
+        const double *result = state.prediction.row(r);
+        const double *expected = validation.output(first + r);
+        for (size_t k = 0; k < output_count; ++k) {
+          const double error = expected[k] - result[k];
+          state.squared_error += error * error;
+        }
+      }
+    }
+  });
+  double squared_error = 0.0;
+  for (size_t s = 0; s < shard_count; ++s) {
+    squared_error += shards[s].squared_error;
+  }
+  return squared_error /
+         static_cast<double>(std::max<size_t>(count, 1) * output_count);
+}
+
+// Stochastic gradient descent, the weights are updated after every sample.
+template <typename Samples>
+void NeuralNetwork::NeuralNetwork::trainOnline(
+        Samples &samples, double eta, double epsilon, size_t max_iterations,
+        const EpochCallback &on_epoch) {
+    auto &delta = workspace.delta;
+    auto &projected_error = workspace.projected_error;
+    const size_t first_epoch = beginTraining();
+    withActivation([&](auto policy) {
+        for (size_t j = first_epoch; j < max_iterations; ++j) {
+            NN_PROFILE_SCOPE("epoch");
+            samples.beginEpoch();
+            const double rate = optimizer.schedule.rate(eta, j, max_iterations);
+            EpochTotals totals;
+            for (size_t n = 0; n < samples.size(); ++n) {
+                const double *input = samples.input(n);
+                const double *output = samples.output(n);
+                forward(input);
+                const auto &last = layers.back();
+                delta.resize(last.neurons.size());
+                double max_error = 0.0;
+                for (size_t i = 0; i < delta.size(); ++i) {
+                    const double error = output[i] - last.neurons[i];
+                    max_error = std::max(max_error, std::abs(error));
+                    totals.squared_error += error * error;
+                    delta[i] = error * policy.derivative(last.sums[i]);
                 }
+                totals.correct += classifiedCorrectly(last.neurons.data(),
+                                                      output, delta.size());
+                ++totals.seen;
+                if (max_error < epsilon) continue;
+                totals.converged = false;
+                const Optimizer::Step step =
+                        optimizer.step(rate, ++optimizer_steps);
+                // the sums and activations cached by forward() are all that is
+                // needed, each weight row is read for the projection and then
+                // updated in the same pass
+                for (auto it = std::rbegin(layers); it != std::rend(layers); ++it) {
+                    const bool first_layer = (it == std::rend(layers) - 1);
+                    NN_PROFILE_SCOPE("backward",
+                                     static_cast<int>(std::rend(layers) - it - 1),
+                                     (first_layer ? 2 : 4) * it->weights.size(),
+                                     2 * it->weights.size() * sizeof(double));
+                    const double *inputs =
+                            first_layer ? input : (it + 1)->neurons.data();
+                    auto &weights = (*it).weights;
+                    const size_t fan_in = weights.cols();
 
-                std::vector<double> projected_error;
-                if (it != std::rend(layers) - 1) {
-                    for (size_t i = 0; i < (it + 1)->neurons.size(); ++i) {
-                        double val = 0.0;
-                        for (size_t j = 0; j < weights.size(); ++j) {
-                            val += output_error.at(j) * state_derivative.at(j) *
-                                    weights.at(j).at(i);
+                    projected_error.assign(first_layer ? 0 : fan_in, 0.0);
+                    for (size_t i = 0; i < weights.rows(); ++i) {
+                        double *row = weights.row(i);
+                        if (!first_layer) {
+                            for (size_t k = 0; k < fan_in; ++k) {
+                                projected_error[k] += delta[i] * row[k];
+                            }
+                        }
+                        const double d = delta[i];
+                        optimizer.update(step, row, stateRow(it->first_moment, i),
+                                         stateRow(it->second_moment, i), fan_in,
+                                         [d, inputs](size_t k) {
+                                             return d * inputs[k];
+                                         });
+                        if (it->mask.size()) {
+                            applyMask(it->mask.row(i), row, fan_in);
                         }
-                        projected_error.push_back(val);
+                    }
+                    if (!first_layer) {
+                        const auto &sums = (it + 1)->sums;
+                        for (size_t k = 0; k < fan_in; ++k) {
+                            projected_error[k] *= policy.derivative(sums[k]);
+                        }
+                        delta.swap(projected_error);
                     }
                 }
-
-                for (size_t i = 0; i < (*it).neurons.size(); ++i) {
-                    std::vector<double> delta =
-                            Neuron::detaRule(inputs, weights.at(i), output_error.at(i), neuron,
-                                             neuronDerivative, eta);
-                    std::transform(std::begin(delta), std::end(delta),
-                                   std::begin(weights.at(i)), std::begin(weights.at(i)),
-                                   std::plus<>());
-                }
-                output_error = projected_error;
             }
-            in_it++;
-            out_it++;
+            const bool more = endEpoch(j, max_iterations, totals, on_epoch);
+            checkpoint(j + 1, max_iterations, samples);
+            if (!more) break;
+        }
+    });
+    endTraining();
+}
+
+// Mini-batch gradient descent, see descend().
+template <typename Samples>
+void NeuralNetwork::NeuralNetwork::trainBatched(
+    Samples &samples, double eta, double epsilon, size_t max_iterations,
+    size_t batch_size, const EpochCallback &on_epoch) {
+  const size_t sample_count = samples.size();
+  if (!sample_count || layers.empty()) return;
+  const size_t input_count = layers.front().weights.cols();
+  const size_t output_count = layers.back().weights.rows();
+
+  for (size_t iteration = beginTraining(); iteration < max_iterations;
+       ++iteration) {
+    NN_PROFILE_SCOPE("epoch");
+    samples.beginEpoch();
+    const double rate = optimizer.schedule.rate(eta, iteration, max_iterations);
+    EpochTotals totals;
+    for (size_t first = 0; first < sample_count; first += batch_size) {
+      const size_t count = std::min(batch_size, sample_count - first);
+      auto fill = [&](size_t begin, size_t end, BatchState &state) {
+        state.input.resize(end - begin, input_count);
+        state.output.resize(end - begin, output_count);
+        for (size_t b = begin; b < end; ++b) {
+          std::copy_n(samples.input(first + b), input_count,
+                      state.input.row(b - begin));
+          std::copy_n(samples.output(first + b), output_count,
+                      state.output.row(b - begin));
         }
+      };
+      descend(count, rate, epsilon, fill, totals);
     }
+    const bool more = endEpoch(iteration, max_iterations, totals, on_epoch);
+    checkpoint(iteration + 1, max_iterations, samples);
+    if (!more) break;
+  }
+  endTraining();
+}
+
+void NeuralNetwork::NeuralNetwork::train(
+    std::vector<std::vector<double>> &input,
+    std::vector<std::vector<double>> &output, double eta, double epsilon,
+    size_t max_iterations, size_t batch_size, const EpochCallback &on_epoch) {
+  VectorSamples samples{input, output};
+  if (batch_size > 1) {
+    trainBatched(samples, eta, epsilon, max_iterations, batch_size, on_epoch);
+  } else {
+    trainOnline(samples, eta, epsilon, max_iterations, on_epoch);
+  }
+}
+
+void NeuralNetwork::NeuralNetwork::train(SampleView &samples, double eta,
+                                         double epsilon, size_t max_iterations,
+                                         size_t batch_size,
+                                         const EpochCallback &on_epoch) {
+  if (samples.inputCount() != inputCount() ||
+      samples.outputCount() != outputCount()) {
+    throw std::invalid_argument("samples do not match the network");
+  }
+  if (resumed && !resumed->sample_order.empty()) {
+    samples.restore(resumed->sample_order, resumed->sample_engine);
+  }
+  if (batch_size > 1) {
+    trainBatched(samples, eta, epsilon, max_iterations, batch_size, on_epoch);
+  } else {
+    trainOnline(samples, eta, epsilon, max_iterations, on_epoch);
+  }
+}
+
+void NeuralNetwork::NeuralNetwork::train(BatchStream &stream, double eta,
+                                         double epsilon, size_t max_iterations,
+                                         const EpochCallback &on_epoch) {
+  if (stream.inputCount() != inputCount() ||
+      stream.outputCount() != outputCount()) {
+    throw std::invalid_argument("dataset does not match the network");
+  }
+  if (layers.empty()) return;
+  for (size_t iteration = beginTraining(); iteration < max_iterations;
+       ++iteration) {
+    NN_PROFILE_SCOPE("epoch");
+    stream.rewind();
+    const double rate = optimizer.schedule.rate(eta, iteration, max_iterations);
+    EpochTotals totals;
+    while (const Batch *batch = stream.next()) {
+      auto fill = [batch](size_t begin, size_t end, BatchState &state) {
+        state.input.resize(end - begin, batch->inputs.cols());
+        state.output.resize(end - begin, batch->outputs.cols());
+        std::copy(batch->inputs.row(begin), batch->inputs.row(end),
+                  state.input.begin());
+        std::copy(batch->outputs.row(begin), batch->outputs.row(end),
+                  state.output.begin());
+      };
+      descend(batch->rows(), rate, epsilon, fill, totals);
+    }
+    const bool more = endEpoch(iteration, max_iterations, totals, on_epoch);
+    checkpoint(iteration + 1, max_iterations, stream);
+    if (!more) break;
+  }
+  endTraining();
 }
 
 NeuralNetwork::NeuralNetworkBuilder &
 NeuralNetwork::NeuralNetworkBuilder::setTheta(double theta) {
-  this->theta = theta;
+  this->parameters.theta = theta;
+  return *this;
+}
+
+NeuralNetwork::NeuralNetworkBuilder &
+NeuralNetwork::NeuralNetworkBuilder::setBeta(double beta) {
+  this->parameters.beta = beta;
   return *this;
 }
 
@@ -114,10 +815,20 @@ NeuralNetwork::NeuralNetworkBuilder::setOutputNeurons(size_t neurons) {
   return *this;
 }
 
+NeuralNetwork::NeuralNetworkBuilder &
+NeuralNetwork::NeuralNetworkBuilder::setActivation(
+    Neuron::Activation activation) {
+  this->activation = activation;
+  return *this;
+}
+
+// custom functions are evaluated through std::function, prefer
+// setActivation for the built in ones
 NeuralNetwork::NeuralNetworkBuilder &
 NeuralNetwork::NeuralNetworkBuilder::setSigmoid(
     std::function<double(double)> sigmoid) {
   this->sigmoid = sigmoid;
+  this->activation = Neuron::Activation::Custom;
   return *this;
 }
 
@@ -128,38 +839,37 @@ NeuralNetwork::NeuralNetworkBuilder::setSigmoidDerivative(
   return *this;
 }
 
+NeuralNetwork::NeuralNetworkBuilder &
+NeuralNetwork::NeuralNetworkBuilder::setSeed(uint64_t seed) {
+  this->seed = seed;
+  return *this;
+}
+
 std::unique_ptr<NeuralNetwork::NeuralNetwork>
 NeuralNetwork::NeuralNetworkBuilder::build() {
-  std::random_device rand_device;
-  std::default_random_engine rand_engine(rand_device());
+  std::mt19937_64 rand_engine(seed);
   std::uniform_real_distribution<double> uniform_dist(-1.0, 1.0);
   auto network = std::make_unique<NeuralNetwork>();
   network->layers.reserve(intermediate_layers + 1);
   network->layers.resize(intermediate_layers + 1);
   for (auto it = std::begin(network->layers); it != std::end(network->layers);
        ++it) {
-    if (it == (std::end(network->layers) - 1)) {
-      (*it).neurons.resize(output_neurons);
-      (*it).weights.resize(output_neurons);
-    } else {
-      (*it).neurons.resize(intermediate_neurons);
-      (*it).weights.resize(intermediate_neurons);
-    }
-    std::fill(std::begin((*it).neurons), std::end((*it).neurons), 0);
-    for (auto &neuron_weights : (*it).weights) {
-      if (it == std::begin(network->layers)) {
-        neuron_weights.resize(input_neurons);
-      } else {
-        neuron_weights.resize(intermediate_neurons);
-      }
-      std::generate(std::begin(neuron_weights), std::end(neuron_weights),
-                    [&uniform_dist, &rand_engine]() {
-                      return uniform_dist(rand_engine);
-                    });
-    }
+    size_t neurons = (it == (std::end(network->layers) - 1))
+                         ? output_neurons
+                         : intermediate_neurons;
+    size_t fan_in = (it == std::begin(network->layers)) ? input_neurons
+                                                        : intermediate_neurons;
+    (*it).neurons.assign(neurons, 0);
+    (*it).sums.assign(neurons, 0);
+    (*it).weights.resize(neurons, fan_in);
+    std::generate(std::begin((*it).weights), std::end((*it).weights),
+                  [&uniform_dist, &rand_engine]() {
+                    return uniform_dist(rand_engine);
+                  });
   }
   network->neuron.swap(this->sigmoid);
   network->neuronDerivative.swap(this->sigmoidDerivative);
-  network->theta = theta;
+  network->activation = activation;
+  network->parameters = parameters;
   return network;
 }
@@ -1,44 +1,251 @@
 #ifndef NETWORK_H
 #define NETWORK_H
 #include <algorithm>
+#include <cstdint>
 #include <functional>
+#include <limits>
 #include <memory>
 #include <random>
+#include <utility>
 #include <vector>
+#include "activation.h"
+#include "batchstream.h"
+#include "checkpoint.h"
+#include "matrix.h"
 #include "neuron.h"
+#include "optimizer.h"
+#include "samples.h"
+#include "sparsematrix.h"
+#include "threadpool.h"
 namespace NeuralNetwork {
 class NeuralNetworkBuilder;
+class ModelFile;
+class Checkpoint;
+// progress of one training epoch, see NeuralNetwork::train
+struct EpochReport {
+  size_t epoch;
+  size_t epochs;
+  // mean squared output error over the samples seen in the epoch
+  double loss;
+  // share of those samples whose strongest output is the expected class
+  double accuracy;
+  // mean squared output error on the validation set after the epoch, NaN
+  // without early stopping
+  double validation_loss{std::numeric_limits<double>::quiet_NaN()};
+};
+// weights removed by NeuralNetwork::prune, a weight goes when either rule
+// selects it
+struct Pruning {
+  // magnitude below which weights are removed
+  double threshold{0.0};
+  // share of the weights of every layer to remove, smallest magnitudes
+  // first, in [0, 1)
+  double sparsity{0.0};
+};
+// invoked on the training thread after every epoch, returning false stops
+// the training
+using EpochCallback = std::function<bool(const EpochReport &)>;
 class NeuralNetwork {
  public:
   std::vector<double> simulate(std::vector<double> &input);
+  // writes outputCount() values to output, does not allocate
+  void simulate(const double *input, double *output);
+  // Runs every row of inputs through the network. Only reads the network
+  // and uses per-thread scratch buffers, so any number of threads may call
+  // it concurrently as long as nobody trains the network meanwhile.
+  Matrix predictBatch(const Matrix &inputs) const;
+  // as above, writing into outputs which is resized to rows x outputCount().
+  // Throws std::invalid_argument unless inputs has inputCount() columns.
+  void predictBatch(const Matrix &inputs, Matrix &outputs) const;
+  size_t inputCount() const;
+  size_t outputCount() const;
+  size_t layerCount() const;
+  // neurons x fan-in weights of the given layer
+  const Matrix &layerWeights(size_t layer) const;
+  // whether simulate() and predictBatch() run the layer on a compressed
+  // sparse copy of its weights, which layers get once few enough of their
+  // weights are non-zero
+  bool layerIsSparse(size_t layer) const;
+  Neuron::Activation activationFunction() const;
+  const Neuron::ActivationParameters &activationParameters() const;
+  // Every train() runs up to max_iterations epochs with the learning rate
+  // eta as adjusted by the optimizer's schedule. Samples whose outputs are
+  // all within epsilon of the expected ones leave the weights alone, the
+  // training ends after an epoch in which that held for every sample.
   void train(std::vector<std::vector<double> > &input,
                             std::vector<std::vector<double> > &output, double eta,
-                            double epsilon, size_t max_iterations);
+                            double epsilon, size_t max_iterations,
+                            size_t batch_size = 1,
+                            const EpochCallback &on_epoch = nullptr);
+  // as above on the samples of a view, which is reshuffled before every
+  // epoch if it asks for it
+  void train(SampleView &samples, double eta, double epsilon,
+             size_t max_iterations, size_t batch_size = 1,
+             const EpochCallback &on_epoch = nullptr);
+  // Mini-batch training on a streamed dataset, one pass over the stream per
+  // iteration with the stream's batch size. Samples are never held in memory
+  // beyond the two prefetched batches.
+  void train(BatchStream &stream, double eta, double epsilon,
+             size_t max_iterations, const EpochCallback &on_epoch = nullptr);
 
+  // mean squared error over the outputs for one sample, the per-sample term
+  // of Evaluation::mean_squared_error; use an Evaluator for whole sets
   double test(std::vector<double> &input, std::vector<double> &output);
+  double test(const double *input, const double *output);
+
+  // threads used by the batched training path, one disables the pool
+  void setThreadCount(size_t threads);
+  size_t threadCount() const;
+  // replaces the optimizer and clears the state of the previous one
+  void setOptimizer(const Optimizer &optimizer);
+  const Optimizer &optimizerSettings() const;
+  // the loss on validation is measured after every epoch of the following
+  // trainings, which stop early as configured
+  void setEarlyStopping(SampleView validation,
+                        const EarlyStopping &stopping = EarlyStopping());
+  void clearEarlyStopping();
+  // the following trainings hand their state to writer whenever it has a
+  // checkpoint due, see Checkpoint::resume for continuing from one
+  void setCheckpoints(std::shared_ptr<CheckpointWriter> writer);
+  void clearCheckpoints();
+  // Zeroes the weights selected by pruning and keeps them at zero through
+  // the following trainings, which fine-tune the remaining ones. Weights
+  // pruned before stay pruned. Returns the share of all weights pruned.
+  double prune(const Pruning &pruning);
+  // lets the following trainings move the pruned weights again
+  void clearPruning();
 private:
   friend class NeuralNetworkBuilder;
+  friend class ModelFile;
+  friend class Checkpoint;
   struct NetworkLayer {
     std::vector<double> neurons;
-    std::vector<std::vector<double>> weights;
+    // summed inputs of the last forward pass, kept for backpropagation
+    std::vector<double> sums;
+    // neurons.size() rows of fan-in weights each, row-major
+    Matrix weights;
+    // optimizer state shaped like weights, left empty when the optimizer
+    // does not need it: velocity or Adam's first moment, Adam's second
+    // moment
+    Matrix first_moment;
+    Matrix second_moment;
+    // 1 for weights kept and 0 for pruned ones, empty unless pruned
+    Matrix mask;
+    // copy of weights for inference when sparse enough, empty otherwise
+    // and while training
+    SparseMatrix sparse;
+  };
+  // buffers of one shard of a training batch
+  struct BatchState {
+    Matrix input;
+    Matrix output;
+    std::vector<Matrix> sums;
+    std::vector<Matrix> activations;
+    std::vector<Matrix> deltas;
+    std::vector<Matrix> gradients;
+    Matrix prediction;
+    double max_error{0.0};
+    double squared_error{0.0};
+    size_t correct{0};
+  };
+  // running sums of the current epoch
+  struct EpochTotals {
+    double squared_error{0.0};
+    size_t correct{0};
+    size_t seen{0};
+    // no sample of the epoch was outside of epsilon
+    bool converged{true};
   };
+  // scratch buffers kept between calls so that after the first sample
+  // neither inference nor training allocate
+  struct Workspace {
+    std::vector<double> delta;
+    std::vector<double> projected_error;
+    std::vector<BatchState> shards;
+    // early stopping of the running training
+    std::vector<Matrix> best_weights;
+    double best_loss{0.0};
+    size_t stale_epochs{0};
+  };
+  // runs body with the activation policy of the network, see
+  // Neuron::dispatch
+  template <typename Body>
+  decltype(auto) withActivation(Body &&body) const {
+    return Neuron::dispatch(activation, parameters, neuron, neuronDerivative,
+                            std::forward<Body>(body));
+  }
+  void forward(const double *input);
+  template <typename Task>
+  void parallel(size_t count, Task &&task) {
+    if (pool) {
+      pool->run(count, std::forward<Task>(task));
+    } else {
+      for (size_t i = 0; i < count; ++i) task(i);
+    }
+  }
+  void backpropagate(BatchState &state) const;
+  template <typename Fill>
+  bool descend(size_t count, double eta, double epsilon, Fill &&fill,
+               EpochTotals &totals);
+  // Samples provides size(), input(i), output(i) and beginEpoch() like
+  // SampleView
+  template <typename Samples>
+  void trainOnline(Samples &samples, double eta, double epsilon,
+                   size_t max_iterations, const EpochCallback &on_epoch);
+  template <typename Samples>
+  void trainBatched(Samples &samples, double eta, double epsilon,
+                    size_t max_iterations, size_t batch_size,
+                    const EpochCallback &on_epoch);
+  // returns the first epoch, the one after the checkpoint when resumed
+  size_t beginTraining();
+  // reports the epoch, false if training should stop
+  bool endEpoch(size_t epoch, size_t epochs, const EpochTotals &totals,
+                const EpochCallback &on_epoch);
+  // offers the state after epoch epochs done to the checkpoint writer
+  template <typename Samples>
+  void checkpoint(size_t epoch, size_t epochs, const Samples &samples);
+  void captureState(size_t epoch, size_t epochs, TrainingState &state) const;
+  void endTraining();
+  // rebuilds the sparse copies of the weights
+  void compressLayers();
+  double validationLoss();
+
   std::vector<NetworkLayer> layers;
-  double theta{0.0};
+  Neuron::ActivationParameters parameters;
 
+  Neuron::Activation activation{Neuron::Activation::Custom};
   std::function<double(double)> neuron;
   std::function<double(double)> neuronDerivative;
+
+  Optimizer optimizer;
+  // updates applied since the optimizer state was cleared
+  size_t optimizer_steps{0};
+  SampleView validation;
+  EarlyStopping early_stopping;
+  std::shared_ptr<CheckpointWriter> checkpoints;
+  // state of the checkpoint this network was resumed from, consumed by the
+  // next training
+  std::unique_ptr<TrainingState> resumed;
+
+  std::unique_ptr<ThreadPool> pool;
+  Workspace workspace;
 };
 
 class NeuralNetworkBuilder {
  public:
+  // threshold of the built in activations, see ActivationParameters
   NeuralNetworkBuilder &setTheta(double theta);
+  NeuralNetworkBuilder &setBeta(double beta);
   NeuralNetworkBuilder &setIntermediateLayers(size_t layers);
   NeuralNetworkBuilder &setIntermediateNeurons(size_t neurons);
   NeuralNetworkBuilder &setInputNeurons(size_t neurons);
   NeuralNetworkBuilder &setOutputNeurons(size_t neurons);
+  NeuralNetworkBuilder &setActivation(Neuron::Activation activation);
   NeuralNetworkBuilder &setSigmoid(std::function<double(double)> sigmoid);
   NeuralNetworkBuilder &setSigmoidDerivative(
       std::function<double(double)> derivative);
+  // seed of the initial weights, random unless set
+  NeuralNetworkBuilder &setSeed(uint64_t seed);
   std::unique_ptr<NeuralNetwork> build();
 
  private:
@@ -46,9 +253,11 @@ class NeuralNetworkBuilder {
   size_t intermediate_neurons;
   size_t input_neurons;
   size_t output_neurons;
-  double theta {0.0};
+  Neuron::ActivationParameters parameters;
+  Neuron::Activation activation{Neuron::Activation::Logistic};
   std::function<double(double)> sigmoid;
   std::function<double(double)> sigmoidDerivative;
+  uint64_t seed{std::random_device{}()};
 };
 }  // namespace NeuralNetwork
 #endif  // NETWORK_H
@@ -4,6 +4,7 @@
 #include <cmath>
 #include <numeric>
 #include <vector>
+#include "kernels.h"
 namespace Neuron {
 inline double heaviside(double in) { return in >= 0.0; }
 inline double sign(double in) {
@@ -11,8 +12,9 @@ inline double sign(double in) {
   if (in < 0) return -1.0;
   return 0.0;
 }
-static volatile double beta = 1.0;
-inline double logistic(double in) {
+// beta is the steepness, callers owning a model pass their own rather than
+// sharing a global
+inline double logistic(double in, double beta = 1.0) {
   return 1.0 / (1 + std::exp(-1.0 * in * beta));
 }
 inline double hypertan(double in) { return std::tanh(in); }
@@ -20,27 +22,39 @@ inline double hypertan(double in) { return std::tanh(in); }
 template <typename Lambda>
 double neuron(const std::vector<double>& inputs,
               const std::vector<double>& weights, Lambda sigmoid) {
-  return sigmoid(std::inner_product(std::begin(inputs), std::end(inputs),
-                                    std::begin(weights), 0.0f));
+  return sigmoid(Kernels::dot(inputs.data(), weights.data(),
+                             std::min(inputs.size(), weights.size())));
 }
 
-inline double logisticDerivative(double in) {
-  return beta * logistic(in) * logistic(1.0 - in);
+template <typename Lambda>
+double neuron(const double* inputs, const double* weights, size_t size,
+              Lambda sigmoid) {
+  return sigmoid(Kernels::dot(inputs, weights, size));
 }
 
-template <typename Lambda>
+inline double logisticDerivative(double in, double beta = 1.0) {
+  double value = logistic(in, beta);
+  return beta * value * (1.0 - value);
+}
+
+inline double hypertanDerivative(double in) {
+  double value = std::tanh(in);
+  return 1.0 - value * value;
+}
+
+template <typename Lambda, typename Derivative>
 inline std::vector<double> detaRule(const std::vector<double>& inputs,
                                     const std::vector<double>& weights,
                                     double expected, Lambda sigmoid,
-                                    Lambda derivative, double rate = 1.0) {
+                                    Derivative derivative, double rate = 1.0) {
+  // the error term is the same for every input, evaluate it once
+  const double scale = rate * (expected - neuron(inputs, weights, sigmoid)) *
+                       neuron(inputs, weights, derivative);
   std::vector<double> deltaWeight;
   deltaWeight.reserve(weights.size());
-  std::transform(
-      std::begin(inputs), std::end(inputs), std::back_inserter(deltaWeight),
-      [rate, expected, weights, inputs, sigmoid, derivative](double input) {
-        return rate * (expected - neuron(inputs, weights, sigmoid)) *
-               neuron(inputs, weights, derivative) * input;
-      });
+  std::transform(std::begin(inputs), std::end(inputs),
+                 std::back_inserter(deltaWeight),
+                 [scale](double input) { return scale * input; });
   return deltaWeight;
 }
 
@@ -0,0 +1,49 @@
+#include "optimizer.h"
+
+#include <algorithm>
+
+namespace {
+constexpr double pi = 3.14159265358979323846;
+}  // namespace
+
+double NeuralNetwork::LearningRateSchedule::rate(double eta, size_t epoch,
+                                                 size_t epochs) const {
+  switch (kind) {
+    case Kind::Constant:
+      break;
+    case Kind::Step:
+      return eta * std::pow(factor, static_cast<double>(
+                                        epoch / std::max<size_t>(step_epochs, 1)));
+    case Kind::Exponential:
+      return eta * std::pow(factor, static_cast<double>(epoch));
+    case Kind::Cosine: {
+      if (epochs < 2) break;
+      const double progress =
+          static_cast<double>(epoch) / static_cast<double>(epochs - 1);
+      const double low = eta * minimum;
+      return low + 0.5 * (eta - low) * (1.0 + std::cos(pi * progress));
+    }
+  }
+  return eta;
+}
+
+size_t NeuralNetwork::Optimizer::stateCount() const {
+  switch (method) {
+    case Method::SGD:
+      return 0;
+    case Method::Momentum:
+    case Method::Nesterov:
+      return 1;
+    case Method::Adam:
+      return 2;
+  }
+  return 0;
+}
+
+NeuralNetwork::Optimizer::Step NeuralNetwork::Optimizer::step(
+    double rate, size_t step) const {
+  if (method != Method::Adam) return {rate, 1.0, 1.0};
+  const auto t = static_cast<double>(std::max<size_t>(step, 1));
+  return {rate, 1.0 / (1.0 - std::pow(beta1, t)),
+          1.0 / (1.0 - std::pow(beta2, t))};
+}
@@ -0,0 +1,95 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+#include <cmath>
+#include <cstddef>
+namespace NeuralNetwork {
+// How the learning rate changes over the epochs of a training.
+struct LearningRateSchedule {
+  enum class Kind { Constant, Step, Exponential, Cosine };
+  Kind kind{Kind::Constant};
+  // Step: eta is multiplied by factor every step_epochs epochs,
+  // Exponential: by factor after every epoch
+  double factor{0.5};
+  size_t step_epochs{10};
+  // Cosine: share of eta reached at the last epoch
+  double minimum{0.0};
+
+  double rate(double eta, size_t epoch, size_t epochs) const;
+};
+
+// Turns the gradients of a layer into weight updates. Momentum and Nesterov
+// keep a velocity per weight, Adam the first and second moment, the network
+// stores that state next to the weights of each layer.
+struct Optimizer {
+  enum class Method { SGD, Momentum, Nesterov, Adam };
+  Method method{Method::SGD};
+  double momentum{0.9};
+  // Adam decay rates of the moments and the term keeping its division
+  // finite
+  double beta1{0.9};
+  double beta2{0.999};
+  double epsilon{1e-8};
+  LearningRateSchedule schedule;
+
+  // learning rate and Adam bias corrections shared by all weights of one
+  // update
+  struct Step {
+    double rate;
+    double first_correction;
+    double second_correction;
+  };
+
+  // state matrices needed per layer, 0 to 2
+  size_t stateCount() const;
+  // the step-th update since the state was cleared, counting from 1
+  Step step(double rate, size_t step) const;
+  // Updates count weights. gradient(k) yields the direction that lowers the
+  // error for weight k, first and second are its state and may be null if
+  // stateCount() says so.
+  template <typename Gradient>
+  void update(const Step &step, double *weights, double *first,
+              double *second, size_t count, Gradient &&gradient) const {
+    switch (method) {
+      case Method::SGD:
+        for (size_t k = 0; k < count; ++k) {
+          weights[k] += step.rate * gradient(k);
+        }
+        break;
+      case Method::Momentum:
+        for (size_t k = 0; k < count; ++k) {
+          first[k] = momentum * first[k] + gradient(k);
+          weights[k] += step.rate * first[k];
+        }
+        break;
+      case Method::Nesterov:
+        // looks ahead along the updated velocity
+        for (size_t k = 0; k < count; ++k) {
+          const double g = gradient(k);
+          first[k] = momentum * first[k] + g;
+          weights[k] += step.rate * (g + momentum * first[k]);
+        }
+        break;
+      case Method::Adam:
+        for (size_t k = 0; k < count; ++k) {
+          const double g = gradient(k);
+          first[k] = beta1 * first[k] + (1.0 - beta1) * g;
+          second[k] = beta2 * second[k] + (1.0 - beta2) * g * g;
+          weights[k] += step.rate * first[k] * step.first_correction /
+                        (std::sqrt(second[k] * step.second_correction) +
+                         epsilon);
+        }
+        break;
+    }
+  }
+};
+
+// Ends a training once the loss on a validation set has not improved by more
+// than min_improvement for patience epochs in a row.
+struct EarlyStopping {
+  size_t patience{10};
+  double min_improvement{0.0};
+  // put back the weights of the epoch with the lowest validation loss
+  bool restore_best{true};
+};
+}  // namespace NeuralNetwork
+#endif  // OPTIMIZER_H
@@ -0,0 +1,283 @@
+#include "perceptronbatch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define PERCEPTRONBATCH_X86 1
+// the block loop is inlined into every instruction set variant below
+#define BLOCK_INLINE __attribute__((always_inline)) inline
+#else
+#define BLOCK_INLINE inline
+#endif
+
+namespace {
+using NeuralNetwork::PerceptronBatch;
+constexpr size_t lanes = PerceptronBatch::lanes;
+// blocks handed to a thread at once, enough to hide the scheduling
+constexpr size_t blocksPerTask = 16;
+
+// one block of neurons, every array but the inputs and weights holds lanes
+// values
+struct Block {
+  double *weights;
+  const double *inputs;
+  const double *expected;
+  const double *rate;
+  double *error;
+  uint32_t *iterations;
+  uint8_t *reached;
+  size_t input_count;
+  // neurons of the block, the last block may be partial
+  size_t valid;
+  double limit;
+  size_t max_iterations;
+};
+
+// derivatives from the sums and the activation values, the built in
+// functions get theirs from the value and skip a second exp
+BLOCK_INLINE void slopes(const Neuron::Policy::Heaviside &, const double *,
+                         const double *, double *slope) {
+  std::fill(slope, slope + lanes, 1.0);
+}
+
+BLOCK_INLINE void slopes(const Neuron::Policy::Sign &, const double *,
+                         const double *, double *slope) {
+  std::fill(slope, slope + lanes, 1.0);
+}
+
+BLOCK_INLINE void slopes(const Neuron::Policy::Logistic &policy,
+                         const double *, const double *value, double *slope) {
+  for (size_t j = 0; j < lanes; ++j) {
+    slope[j] = policy.beta * value[j] * (1.0 - value[j]);
+  }
+}
+
+BLOCK_INLINE void slopes(const Neuron::Policy::Tanh &, const double *,
+                         const double *value, double *slope) {
+  for (size_t j = 0; j < lanes; ++j) slope[j] = 1.0 - value[j] * value[j];
+}
+
+// only instantiated for the custom branch of dispatch, which train() never
+// takes
+BLOCK_INLINE void slopes(const Neuron::Policy::Custom &policy,
+                         const double *sum, const double *, double *slope) {
+  for (size_t j = 0; j < lanes; ++j) slope[j] = policy.derivative(sum[j]);
+}
+
+// The lanes of a row are independent, restrict tells the compiler so and
+// lets it keep the sums of a block in vector registers.
+BLOCK_INLINE void weightedSums(const double *__restrict weights,
+                               const double *__restrict inputs,
+                               size_t input_count, double *__restrict sum) {
+  std::fill(sum, sum + lanes, 0.0);
+  for (size_t k = 0; k < input_count; ++k) {
+    const double *w = weights + k * lanes;
+    const double *x = inputs + k * lanes;
+    for (size_t j = 0; j < lanes; ++j) sum[j] += w[j] * x[j];
+  }
+}
+
+// weights += scale * inputs and the new sums in the same pass over the block
+BLOCK_INLINE void update(double *__restrict weights,
+                         const double *__restrict inputs, size_t input_count,
+                         const double *__restrict scale,
+                         double *__restrict sum) {
+  std::fill(sum, sum + lanes, 0.0);
+  for (size_t k = 0; k < input_count; ++k) {
+    double *w = weights + k * lanes;
+    const double *x = inputs + k * lanes;
+    for (size_t j = 0; j < lanes; ++j) {
+      w[j] += scale[j] * x[j];
+      sum[j] += w[j] * x[j];
+    }
+  }
+}
+
+// Neuron::trainNeuron for the lanes of a block at once. A converged lane
+// keeps iterating with a zero step, which leaves its weights untouched.
+template <typename Policy>
+BLOCK_INLINE void trainBlock(const Policy &policy, const Block &block) {
+  alignas(64) double sum[lanes];
+  alignas(64) double value[lanes];
+  alignas(64) double slope[lanes];
+  alignas(64) double scale[lanes];
+  alignas(64) double active[lanes];
+  size_t remaining = block.valid;
+  for (size_t j = 0; j < lanes; ++j) active[j] = j < block.valid ? 1.0 : 0.0;
+
+  weightedSums(block.weights, block.inputs, block.input_count, sum);
+  policy.activate(sum, value, lanes);
+  for (size_t j = 0; j < lanes; ++j) {
+    block.error[j] = std::abs(block.expected[j] - value[j]);
+    block.iterations[j] = 0;
+    block.reached[j] = 0;
+  }
+  for (size_t i = 0; i < block.max_iterations && remaining; ++i) {
+    slopes(policy, sum, value, slope);
+    for (size_t j = 0; j < lanes; ++j) {
+      scale[j] = active[j] * block.rate[j] *
+                 (block.expected[j] - value[j]) * slope[j];
+    }
+    update(block.weights, block.inputs, block.input_count, scale, sum);
+    policy.activate(sum, value, lanes);
+    for (size_t j = 0; j < lanes; ++j) {
+      if (active[j] == 0.0) continue;
+      block.error[j] = std::abs(block.expected[j] - value[j]);
+      block.iterations[j] = static_cast<uint32_t>(i + 1);
+      if (block.error[j] < block.limit) {
+        block.reached[j] = 1;
+        active[j] = 0.0;
+        --remaining;
+      }
+    }
+  }
+}
+
+template <typename Policy>
+void trainBlockScalar(const Policy &policy, const Block &block) {
+  trainBlock(policy, block);
+}
+
+#ifdef PERCEPTRONBATCH_X86
+template <typename Policy>
+__attribute__((target("avx2,fma"))) void trainBlockAvx2(const Policy &policy,
+                                                        const Block &block) {
+  trainBlock(policy, block);
+}
+
+template <typename Policy>
+__attribute__((target("avx512f,avx2,fma"))) void trainBlockAvx512(
+    const Policy &policy, const Block &block) {
+  trainBlock(policy, block);
+}
+#endif
+
+template <typename Policy>
+using BlockTrainer = void (*)(const Policy &, const Block &);
+
+template <typename Policy>
+BlockTrainer<Policy> selectTrainer() {
+#ifdef PERCEPTRONBATCH_X86
+  __builtin_cpu_init();
+  const bool avx2 =
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  if (__builtin_cpu_supports("avx512f") && avx2) {
+    return trainBlockAvx512<Policy>;
+  }
+  if (avx2) return trainBlockAvx2<Policy>;
+#endif
+  return trainBlockScalar<Policy>;
+}
+
+template <typename Policy>
+BlockTrainer<Policy> blockTrainer() {
+  static const BlockTrainer<Policy> trainer = selectTrainer<Policy>();
+  return trainer;
+}
+}  // namespace
+
+NeuralNetwork::PerceptronBatch::PerceptronBatch(size_t neurons, size_t inputs,
+                                                size_t threads)
+    : neuron_count(neurons),
+      input_count(inputs),
+      block_count((neurons + lanes - 1) / lanes),
+      input_values(block_count * inputs, lanes),
+      weight_values(block_count * inputs, lanes),
+      expected_values(block_count * lanes, 0.0),
+      rates(block_count * lanes, 0.0),
+      errors(block_count * lanes, 0.0),
+      iteration_counts(block_count * lanes, 0),
+      reached(block_count * lanes, 0),
+      pool(std::max<size_t>(threads, 1)) {
+  if (!neurons || !inputs) {
+    throw std::invalid_argument("a perceptron batch needs neurons and inputs");
+  }
+}
+
+size_t NeuralNetwork::PerceptronBatch::offset(size_t neuron, size_t k) const {
+  return ((neuron / lanes) * input_count + k) * lanes + neuron % lanes;
+}
+
+void NeuralNetwork::PerceptronBatch::setNeuron(size_t neuron,
+                                               const double *inputs,
+                                               const double *weights,
+                                               double expected, double rate) {
+  setInputs(neuron, inputs);
+  setWeights(neuron, weights);
+  setExpected(neuron, expected);
+  setRate(neuron, rate);
+}
+
+void NeuralNetwork::PerceptronBatch::setInputs(size_t neuron,
+                                               const double *inputs) {
+  double *values = input_values.data();
+  for (size_t k = 0; k < input_count; ++k) {
+    values[offset(neuron, k)] = inputs[k];
+  }
+}
+
+void NeuralNetwork::PerceptronBatch::setWeights(size_t neuron,
+                                                const double *weights) {
+  double *values = weight_values.data();
+  for (size_t k = 0; k < input_count; ++k) {
+    values[offset(neuron, k)] = weights[k];
+  }
+}
+
+void NeuralNetwork::PerceptronBatch::setExpected(size_t neuron,
+                                                 double expected) {
+  expected_values[neuron] = expected;
+}
+
+void NeuralNetwork::PerceptronBatch::setRate(size_t neuron, double rate) {
+  rates[neuron] = rate;
+}
+
+void NeuralNetwork::PerceptronBatch::weights(size_t neuron,
+                                             double *weights) const {
+  const double *values = weight_values.data();
+  for (size_t k = 0; k < input_count; ++k) {
+    weights[k] = values[offset(neuron, k)];
+  }
+}
+
+std::vector<double> NeuralNetwork::PerceptronBatch::weights(
+    size_t neuron) const {
+  std::vector<double> values(input_count);
+  weights(neuron, values.data());
+  return values;
+}
+
+size_t NeuralNetwork::PerceptronBatch::train(
+    Neuron::Activation activation,
+    const Neuron::ActivationParameters &parameters, double limit,
+    size_t max_iterations) {
+  if (activation == Neuron::Activation::Custom) {
+    throw std::invalid_argument(
+        "perceptron batches need a built in activation");
+  }
+  const std::function<double(double)> none;
+  Neuron::dispatch(activation, parameters, none, none, [&](auto policy) {
+    const auto trainer = blockTrainer<decltype(policy)>();
+    const size_t tasks = (block_count + blocksPerTask - 1) / blocksPerTask;
+    pool.run(tasks, [&](size_t t) {
+      const size_t end = std::min(block_count, (t + 1) * blocksPerTask);
+      for (size_t b = t * blocksPerTask; b < end; ++b) {
+        const size_t first = b * lanes;
+        trainer(policy,
+                Block{weight_values.row(b * input_count),
+                      input_values.row(b * input_count),
+                      expected_values.data() + first, rates.data() + first,
+                      errors.data() + first, iteration_counts.data() + first,
+                      reached.data() + first, input_count,
+                      std::min(lanes, neuron_count - first), limit,
+                      max_iterations});
+      }
+    });
+  });
+  return static_cast<size_t>(
+      std::count(reached.begin(), reached.begin() + neuron_count, 1));
+}
@@ -0,0 +1,74 @@
+#ifndef PERCEPTRONBATCH_H
+#define PERCEPTRONBATCH_H
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "activation.h"
+#include "matrix.h"
+#include "threadpool.h"
+namespace NeuralNetwork {
+// Many independent single neurons trained with the delta rule of
+// Neuron::trainNeuron, each on its own input vector, expected output and
+// learning rate. Every iteration moves the weights by
+// rate * (expected - f(w.x)) * f'(w.x) * x and a neuron stops once
+// |expected - f(w.x)| drops below the limit.
+//
+// The neurons are stored structure-of-arrays in blocks of `lanes`: input k
+// of the neurons of a block lies contiguously, so the sums, the updates and
+// the activation run across the neurons of a block in vector registers. The
+// blocks are spread over the pool and a block iterates until all its
+// neurons converged, with the converged ones masked out. The block loop is
+// compiled for AVX-512, AVX2 and the baseline and picked at runtime like the
+// kernels. Custom activations are rejected with std::invalid_argument.
+class PerceptronBatch {
+ public:
+  // neurons of a block, one AVX-512 register of doubles
+  static constexpr size_t lanes = 8;
+
+  PerceptronBatch(size_t neurons, size_t inputs,
+                  size_t threads = std::thread::hardware_concurrency());
+
+  size_t size() const { return neuron_count; }
+  size_t inputCount() const { return input_count; }
+
+  // inputs and weights hold inputCount() values
+  void setNeuron(size_t neuron, const double *inputs, const double *weights,
+                 double expected, double rate);
+  void setInputs(size_t neuron, const double *inputs);
+  void setWeights(size_t neuron, const double *weights);
+  void setExpected(size_t neuron, double expected);
+  void setRate(size_t neuron, double rate);
+
+  // trains every neuron for at most max_iterations, returns the number of
+  // neurons that reached the limit
+  size_t train(Neuron::Activation activation,
+               const Neuron::ActivationParameters &parameters,
+               double limit = 0.5, size_t max_iterations = 100);
+
+  void weights(size_t neuron, double *weights) const;
+  std::vector<double> weights(size_t neuron) const;
+  // |expected - output| after the last iteration of the neuron
+  double error(size_t neuron) const { return errors[neuron]; }
+  size_t iterations(size_t neuron) const { return iteration_counts[neuron]; }
+  bool converged(size_t neuron) const { return reached[neuron] != 0; }
+
+ private:
+  // first value of input k of the block holding neuron
+  size_t offset(size_t neuron, size_t k) const;
+
+  size_t neuron_count;
+  size_t input_count;
+  size_t block_count;
+  // block_count * input_count rows of lanes, row b * input_count + k holds
+  // input k of block b
+  Matrix input_values;
+  Matrix weight_values;
+  std::vector<double> expected_values;
+  std::vector<double> rates;
+  std::vector<double> errors;
+  std::vector<uint32_t> iteration_counts;
+  std::vector<uint8_t> reached;
+  ThreadPool pool;
+};
+}  // namespace NeuralNetwork
+#endif  // PERCEPTRONBATCH_H
@@ -1,22 +1,80 @@
 #include "perceptronwindow.h"
+#include <cmath>
+#include <QDir>
+#include <QFileDialog>
+#include "activation.h"
+#include "generator.h"
+#include "profiler.h"
 #include "ui_perceptronwindow.h"
 
+namespace {
+Neuron::Activation activationOf(const QString& function) {
+  if (function == "heaviside") return Neuron::Activation::Heaviside;
+  if (function == "sign") return Neuron::Activation::Sign;
+  if (function == "tanh") return Neuron::Activation::Tanh;
+  return Neuron::Activation::Logistic;
+}
+
+QVector<QPointF> chartPoints(const NeuralNetwork::MinMaxDecimator& decimator) {
+  QVector<QPointF> points;
+  const auto decimated = decimator.points();
+  points.reserve(static_cast<int>(decimated.size()));
+  for (const auto& point : decimated) points.append(QPointF(point.x, point.y));
+  return points;
+}
+}  // namespace
+
 PerceptronWindow::PerceptronWindow(QWidget* parent)
     : QMainWindow(parent), ui(new Ui::PerceptronWindow) {
   ui->setupUi(this);
   this->sigmoidChart = new QtCharts::QChart();
   this->sigmoidChart->legend()->hide();
-  this->sigmoidChart->createDefaultAxes();
+  this->sigmoidSeries = new QtCharts::QLineSeries();
+  this->sigmoidInputAxis = new QtCharts::QValueAxis();
+  this->sigmoidOutputAxis = new QtCharts::QValueAxis();
+  // every built in function stays within [-1, 1]
+  this->sigmoidOutputAxis->setRange(-1.1, 1.1);
+  this->sigmoidChart->addSeries(this->sigmoidSeries);
+  this->sigmoidChart->addAxis(this->sigmoidInputAxis, Qt::AlignBottom);
+  this->sigmoidChart->addAxis(this->sigmoidOutputAxis, Qt::AlignLeft);
+  this->sigmoidSeries->attachAxis(this->sigmoidInputAxis);
+  this->sigmoidSeries->attachAxis(this->sigmoidOutputAxis);
   ui->sigmoidView->setChart(this->sigmoidChart);
   ui->sigmoidView->setRenderHint(QPainter::Antialiasing);
   ui->sigmoidView->setBackgroundBrush(Qt::white);
 
+  this->lossChart = new QtCharts::QChart();
+  this->lossChart->legend()->setAlignment(Qt::AlignBottom);
+  this->lossChart->setTitle("Training loss");
+  this->lossSeries = new QtCharts::QLineSeries();
+  this->lossSeries->setName("Training");
+  this->validationSeries = new QtCharts::QLineSeries();
+  this->validationSeries->setName("Validation");
+  this->lossEpochAxis = new QtCharts::QValueAxis();
+  this->lossEpochAxis->setTitleText("Epoch");
+  this->lossEpochAxis->setLabelFormat("%d");
+  this->lossValueAxis = new QtCharts::QValueAxis();
+  this->lossChart->addSeries(this->lossSeries);
+  this->lossChart->addSeries(this->validationSeries);
+  this->lossChart->addAxis(this->lossEpochAxis, Qt::AlignBottom);
+  this->lossChart->addAxis(this->lossValueAxis, Qt::AlignLeft);
+  for (auto series : {this->lossSeries, this->validationSeries}) {
+    series->attachAxis(this->lossEpochAxis);
+    series->attachAxis(this->lossValueAxis);
+  }
+  ui->lossView->setChart(this->lossChart);
+  ui->lossView->setRenderHint(QPainter::Antialiasing);
+  ui->lossView->setBackgroundBrush(Qt::white);
+
   this->perceptronFunctions.insert("heaviside", Neuron::heaviside);
   this->perceptronFunctions.insert("sign", Neuron::sign);
-  this->perceptronFunctions.insert("logistic", Neuron::logistic);
+  this->perceptronFunctions.insert(
+      "logistic", [this](double in) { return Neuron::logistic(in, neuronBeta); });
   this->perceptronFunctions.insert("tanh", Neuron::hypertan);
 
   ui->functionBox->addItems(this->perceptronFunctions.keys());
+  // in the order of NeuralNetwork::Optimizer::Method
+  ui->networkOptimizerBox->addItems({"SGD", "Momentum", "Nesterov", "Adam"});
   ui->functionBox->setCurrentIndex(1);
   ui->thetaBox->setValue(1.0);
   ui->thetaBox->setSingleStep(0.01);
@@ -60,9 +118,13 @@ PerceptronWindow::PerceptronWindow(QWidget* parent)
   ui->networkIterationsBox->setRange(1, INT_MAX);
 
   disableNetwork();
+  ui->networkCancelButton->setDisabled(true);
 }
 
 PerceptronWindow::~PerceptronWindow() {
+  // the worker trains this->network, stop it before anything goes away
+  this->trainingCancelled = true;
+  if (this->trainingThread.joinable()) this->trainingThread.join();
   while (ui->inputTable->rowCount()) {
     int rows = ui->inputTable->rowCount() - 1;
     delete ui->inputTable->takeItem(rows, 0);
@@ -70,6 +132,7 @@ PerceptronWindow::~PerceptronWindow() {
     ui->inputTable->removeRow(rows);
   }
   delete this->sigmoidChart;
+  delete this->lossChart;
   delete ui;
 }
 
@@ -148,7 +211,7 @@ void PerceptronWindow::on_calculateButton_clicked() {
 }
 
 void PerceptronWindow::on_betaBox_valueChanged(double arg1) {
-  Neuron::beta = arg1;
+  this->neuronBeta = arg1;
   on_functionBox_currentTextChanged(nullptr);
 }
 
@@ -160,20 +223,27 @@ void PerceptronWindow::on_functionBox_currentTextChanged(const QString&) {
     ui->betaBox->setEnabled(true);
     ui->trainButton->setEnabled(true);
   }
-  this->sigmoidChart->removeAllSeries();
-  auto* series = new QtCharts::QLineSeries();
+  // the curve is f(x - theta) around theta, which samples f at the same
+  // points whatever theta is
   double theta = ui->thetaBox->value();
-  std::vector<double> xvals(sigmoidPlotPoints);
-  std::generate(
-      std::begin(xvals), std::end(xvals),
-      [n = theta - sigmoidPlotOffset]() mutable { return n += 0.01; });
-  QString function = ui->functionBox->currentText();
-  for (auto i : xvals) {
-    series->append(i, this->perceptronFunctions.value(function)(i - theta));
+  std::vector<double> sums(sigmoidPlotPoints);
+  std::vector<double> values(sigmoidPlotPoints);
+  std::generate(std::begin(sums), std::end(sums),
+                [n = -sigmoidPlotOffset]() mutable { return n += 0.01; });
+  Neuron::ActivationParameters parameters;
+  parameters.beta = this->neuronBeta;
+  const std::function<double(double)> none;
+  Neuron::dispatch(activationOf(ui->functionBox->currentText()), parameters,
+                   none, none, [&sums, &values](auto policy) {
+                     policy.activate(sums.data(), values.data(), sums.size());
+                   });
+  QVector<QPointF> points;
+  points.reserve(static_cast<int>(sigmoidPlotPoints));
+  for (size_t i = 0; i < sigmoidPlotPoints; ++i) {
+    points.append(QPointF(sums[i] + theta, values[i]));
   }
-  this->sigmoidChart->addSeries(series);
-  this->sigmoidChart->createDefaultAxes();
-  ui->sigmoidView->update();
+  this->sigmoidSeries->replace(points);
+  this->sigmoidInputAxis->setRange(points.first().x(), points.last().x());
 }
 
 void PerceptronWindow::on_thetaBox_valueChanged(double) {
@@ -194,15 +264,21 @@ void PerceptronWindow::on_trainButton_clicked() {
   int maxIterations = ui->maxIterBox->value();
   double epsilon = ui->epsilonBox->value();
   double eta = ui->learningRateBox->value();
+  double beta = this->neuronBeta;
 
   auto trainedWeights = Neuron::trainNeuron(
       weights, expected,
-      [inputs, weights, expected, eta](const auto& w) {
-        return Neuron::detaRule(inputs, w, expected, Neuron::logistic,
-                                Neuron::logisticDerivative, eta);
+      [inputs, weights, expected, eta, beta](const auto& w) {
+        return Neuron::detaRule(
+            inputs, w, expected,
+            [beta](double in) { return Neuron::logistic(in, beta); },
+            [beta](double in) { return Neuron::logisticDerivative(in, beta); },
+            eta);
       },
-      [inputs](const auto& w) {
-        return Neuron::neuron(inputs, w, Neuron::logistic);
+      [inputs, beta](const auto& w) {
+        return Neuron::neuron(inputs, w, [beta](double in) {
+          return Neuron::logistic(in, beta);
+        });
       },
       epsilon, maxIterations,
       [this](double err) { this->addTrainingPoint(err); });
@@ -229,30 +305,207 @@ void PerceptronWindow::on_trainButton_clicked() {
 // neural network handling below
 
 void PerceptronWindow::on_networkTrainButton_clicked() {
-  // go through the train set
-  auto inputs = this->inputTrain;
-  auto outputs = this->outputTrain;
+  if (this->trainingThread.joinable()) return;
   auto eta = ui->networkEtaBox->value();
   auto iterations = static_cast<size_t>(ui->networkIterationsBox->value());
   auto epsilon = ui->networkEpsilonBox->value();
-  network->train(inputs, outputs, eta, epsilon, iterations);
-  ui->outputText->append("Network trained");
+  auto method = static_cast<NeuralNetwork::Optimizer::Method>(
+      ui->networkOptimizerBox->currentIndex());
+  // keeps the optimizer state when training goes on with the same method
+  if (network->optimizerSettings().method != method) {
+    NeuralNetwork::Optimizer optimizer;
+    optimizer.method = method;
+    network->setOptimizer(optimizer);
+  }
+  // a tenth of the generated training samples is held out for early stopping
+  NeuralNetwork::SampleView fitSamples = this->trainSamples;
+  if (ui->networkEarlyStoppingBox->isChecked() && !this->trainStream) {
+    NeuralNetwork::SampleView validationSamples;
+    std::tie(fitSamples, validationSamples) = this->trainSamples.split(0.9);
+    fitSamples.setShuffleEachEpoch(true);
+    network->setEarlyStopping(std::move(validationSamples));
+  } else {
+    network->clearEarlyStopping();
+  }
+  if (ui->networkCheckpointBox->isChecked()) {
+    // the writer of the last training finishes its checkpoint first
+    this->checkpointWriter.reset();
+    this->checkpointWriter = std::make_shared<NeuralNetwork::CheckpointWriter>(
+        QDir::current().filePath(checkpointFile).toStdString(), 1,
+        checkpointSpacing);
+    this->checkpointWriter->setDescription(
+        samplesDescription().toStdString());
+    network->setCheckpoints(this->checkpointWriter);
+  } else {
+    network->clearCheckpoints();
+    this->checkpointWriter.reset();
+  }
+  this->lossSeries->clear();
+  this->validationSeries->clear();
+  this->lossEpochAxis->setRange(0, static_cast<double>(iterations));
+  this->lossValueAxis->setRange(0, 0);
+  this->trainingCancelled = false;
+  NeuralNetwork::Profiling::reset();
+  setTrainingActive(true);
+  ui->outputText->append("Network training started");
+
+  // go through the train set in place, the buttons that could change it or
+  // the network stay disabled until finishTraining
+  this->trainingThread = std::thread([this, eta, iterations, epsilon,
+                                      fitSamples]() mutable {
+    NeuralNetwork::EpochReport latest{0, iterations, 0.0, 0.0};
+    NeuralNetwork::MinMaxDecimator loss(lossPlotBuckets);
+    NeuralNetwork::MinMaxDecimator validation(lossPlotBuckets);
+    auto last_post = std::chrono::steady_clock::now() - progressInterval;
+    auto on_epoch = [this, &latest, &loss, &validation,
+                     &last_post](const NeuralNetwork::EpochReport& report) {
+      latest = report;
+      const double epoch = static_cast<double>(report.epoch + 1);
+      loss.append(epoch, report.loss);
+      if (!std::isnan(report.validation_loss)) {
+        validation.append(epoch, report.validation_loss);
+      }
+      auto now = std::chrono::steady_clock::now();
+      if (now - last_post >= progressInterval) {
+        last_post = now;
+        QMetaObject::invokeMethod(
+            this,
+            [this, report, loss_points = chartPoints(loss),
+             validation_points = chartPoints(validation)]() {
+              addEpochPoint(report, loss_points, validation_points);
+            },
+            Qt::QueuedConnection);
+      }
+      return !this->trainingCancelled.load();
+    };
+    QString failure;
+    try {
+      if (this->trainStream) {
+        network->train(*this->trainStream, eta, epsilon, iterations, on_epoch);
+      } else {
+        network->train(fitSamples, eta, epsilon, iterations, 1, on_epoch);
+      }
+    } catch (const std::exception& e) {
+      failure = e.what();
+    }
+    QMetaObject::invokeMethod(
+        this,
+        [this, latest, failure, loss_points = chartPoints(loss),
+         validation_points = chartPoints(validation)]() {
+          if (!failure.isEmpty()) {
+            ui->outputText->append(QString("Training failed: %1").arg(failure));
+          }
+          finishTraining(latest, loss_points, validation_points);
+        },
+        Qt::QueuedConnection);
+  });
+}
+
+void PerceptronWindow::on_networkCancelButton_clicked() {
+  this->trainingCancelled = true;
+  ui->networkCancelButton->setDisabled(true);
+}
+
+void PerceptronWindow::addEpochPoint(const NeuralNetwork::EpochReport& report,
+                                     const QVector<QPointF>& loss,
+                                     const QVector<QPointF>& validation) {
+  const double epoch = static_cast<double>(report.epoch + 1);
+  this->lossSeries->replace(loss);
+  this->validationSeries->replace(validation);
+  double highest = report.loss;
+  for (const auto& points : {loss, validation}) {
+    for (const auto& point : points) highest = std::max(highest, point.y());
+  }
+  auto line = QString("Epoch %1/%2, loss: %3, accuracy: %4 %")
+                  .arg(epoch)
+                  .arg(report.epochs)
+                  .arg(report.loss)
+                  .arg(report.accuracy * 100.0);
+  if (!std::isnan(report.validation_loss)) {
+    line += QString(", validation loss: %1").arg(report.validation_loss);
+  }
+  if (highest > this->lossValueAxis->max()) {
+    this->lossValueAxis->setMax(highest * 1.1);
+  }
+  ui->outputText->append(line);
+}
+
+void PerceptronWindow::finishTraining(const NeuralNetwork::EpochReport& report,
+                                      const QVector<QPointF>& loss,
+                                      const QVector<QPointF>& validation) {
+  this->trainingThread.join();
+  // the last epoch may have been throttled away
+  if (this->lossSeries->count() == 0 ||
+      this->lossSeries->at(this->lossSeries->count() - 1).x() <
+          static_cast<double>(report.epoch + 1)) {
+    addEpochPoint(report, loss, validation);
+  }
+  setTrainingActive(false);
+  ui->outputText->append(this->trainingCancelled ? "Network training cancelled"
+                                                 : "Network trained");
+  if (this->checkpointWriter) {
+    const auto error = this->checkpointWriter->error();
+    ui->outputText->append(
+        error.empty()
+            ? QString("Checkpoints are written to %1")
+                  .arg(QString::fromStdString(this->checkpointWriter->path()))
+            : QString("Checkpoint failed: %1")
+                  .arg(QString::fromStdString(error)));
+  }
+  if (NeuralNetwork::Profiling::available) showProfile();
+}
+
+// only reached in builds with CONFIG += profiling
+void PerceptronWindow::showProfile() {
+  auto summary = QString::fromStdString(NeuralNetwork::Profiling::summary());
+  ui->outputText->append("<pre>" + summary.toHtmlEscaped() + "</pre>");
+  auto path = QDir::current().filePath("training-trace.json");
+  if (NeuralNetwork::Profiling::writeChromeTrace(path.toStdString())) {
+    ui->outputText->append("Trace written to " + path);
+  } else {
+    ui->outputText->append("Cannot write the trace to " + path);
+  }
+}
+
+void PerceptronWindow::setTrainingActive(bool active) {
+  if (active) {
+    disableNetwork();
+  } else {
+    enableNetwork();
+  }
+  ui->networkCreateButton->setDisabled(active);
+  ui->networkLoadButton->setDisabled(active);
+  ui->networkResumeButton->setDisabled(active);
+  ui->networkCancelButton->setEnabled(active);
 }
 
 void PerceptronWindow::on_networkCalculateButton_clicked() {
   // go through the test set
-  auto inputs = this->inputTest;
-  auto outputs = this->outputTest;
-  double accuracy = 0.0;
-  for (size_t i = 0; i < inputs.size(); ++i) {
-    auto result = network->test(inputs.at(i), outputs.at(i));
-    accuracy += result;
-//    ui->outputText->append(
-//        QString("Network tested, error for a sample: %1 %").arg(result * 100.0));
+  NeuralNetwork::Evaluation result;
+  try {
+    result = this->testStream
+                 ? this->evaluator.evaluate(*network, *this->testStream)
+                 : this->evaluator.evaluate(*network, this->testSamples);
+  } catch (const std::exception& e) {
+    ui->outputText->append(QString("Testing failed: %1").arg(e.what()));
+    return;
   }
   ui->outputText->append(
-      QString("Network tested, average error: %1 %")
-          .arg((accuracy/inputs.size()) * 100.0));
+      QString("Network tested on %1 samples, accuracy: %2 %, MSE: %3, "
+              "cross-entropy: %4")
+          .arg(result.samples)
+          .arg(result.accuracy * 100.0)
+          .arg(result.mean_squared_error)
+          .arg(result.cross_entropy));
+  // rows are the expected classes, columns the predicted ones
+  ui->outputText->append("Confusion matrix:");
+  for (size_t expected = 0; expected < result.classes; ++expected) {
+    QStringList row;
+    for (size_t predicted = 0; predicted < result.classes; ++predicted) {
+      row << QString::number(result.confusionCount(expected, predicted));
+    }
+    ui->outputText->append(row.join('\t'));
+  }
 }
 
 void PerceptronWindow::enableNetwork() {
@@ -265,7 +518,63 @@ void PerceptronWindow::disableNetwork() {
   ui->networkTrainButton->setDisabled(true);
 }
 
+void PerceptronWindow::on_networkLoadButton_clicked() {
+  QString path = QFileDialog::getOpenFileName(
+      this, "Load dataset", QString(),
+      "Datasets (*.csv *.nnd);;Columnar datasets (*.nnd);;CSV files (*.csv)");
+  this->trainStream.reset();
+  this->testStream.reset();
+  this->datasetPath = path;
+  disableNetwork();
+  if (path.isEmpty()) {
+    ui->outputText->append("Using generated sample data");
+    return;
+  }
+  try {
+    openDatasetStreams();
+  } catch (const std::exception& e) {
+    this->datasetPath.clear();
+    ui->outputText->append(QString("Cannot load dataset: %1").arg(e.what()));
+    return;
+  }
+  ui->outputText->append(
+      QString("Loaded dataset %1 with %2 training and %3 test samples, "
+              "create the network to use it")
+          .arg(path)
+          .arg(this->trainStream->rows())
+          .arg(this->testStream->rows()));
+}
+
+// Splits the loaded dataset at the train - test ratio. Text files take the
+// dimensions from the configuration boxes, columnar ones fill them in.
+void PerceptronWindow::openDatasetStreams() {
+  const std::string path = this->datasetPath.toStdString();
+  auto open = [this, &path]() {
+    return NeuralNetwork::openDataset(
+        path, static_cast<size_t>(ui->networkInputsBox->value()),
+        static_cast<size_t>(ui->networkClassesBox->value()));
+  };
+  auto reader = open();
+  const auto rows = reader->rows();
+  const auto split = static_cast<size_t>(
+      std::round(rows * ui->networkSplitRatioBox->value()));
+  ui->networkInputsBox->setValue(static_cast<int>(reader->inputCount()));
+  ui->networkClassesBox->setValue(static_cast<int>(reader->outputCount()));
+  this->trainStream = std::make_unique<NeuralNetwork::BatchStream>(
+      std::move(reader), datasetBatchSize, 0, split);
+  this->testStream = std::make_unique<NeuralNetwork::BatchStream>(
+      open(), datasetBatchSize, split);
+}
+
 void PerceptronWindow::on_networkCreateButton_clicked() {
+  if (!this->datasetPath.isEmpty()) {
+    try {
+      openDatasetStreams();
+    } catch (const std::exception& e) {
+      ui->outputText->append(QString("Cannot load dataset: %1").arg(e.what()));
+      return;
+    }
+  }
   NeuralNetwork::NeuralNetworkBuilder builder;
   auto network_inputs = static_cast<size_t>(ui->networkInputsBox->value());
   auto network_outputs = static_cast<size_t>(ui->networkClassesBox->value());
@@ -276,73 +585,110 @@ void PerceptronWindow::on_networkCreateButton_clicked() {
                       .setOutputNeurons(network_outputs)
                       .setIntermediateLayers(intermediate_layers)
                       .setIntermediateNeurons(intermediate_neurons)
-                      .setSigmoid(Neuron::logistic)
-                      .setSigmoidDerivative(Neuron::logisticDerivative)
+                      .setActivation(Neuron::Activation::Logistic)
+                      .setBeta(ui->networkBetaBox->value())
+                      .setTheta(ui->networkThetaBox->value())
                       .build();
-  Neuron::beta = ui->networkBetaBox->value();
-
-  // generate set and split
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_real_distribution<> dis(0.0, 1000.0 * ui->networkClassesBox->value());
-  std::vector<std::vector<double>> centers;
-  std::generate_n(std::back_inserter(centers), ui->networkClassesBox->value(), [&](){
-      std::vector<double> center;
-      std::generate_n(std::back_inserter(center), ui->networkInputsBox->value(), [&](){
-          return dis(gen);
-      });
-      return center;
-  });
-
-  this->inputData.clear();
-  this->outputData.clear();
-  for (int j = 0; j < ui->networkSamplesBox->value(); ++j){
-      for (size_t i = 0; i < centers.size(); ++i) {
-          std::vector<double> sample;
-          std::for_each(std::begin(centers.at(i)), std::end(centers.at(i)), [&](auto val){
-              std::normal_distribution<> gauss{val, 3.0};
-              sample.push_back(gauss(gen));
-          });
-          this->inputData.push_back(sample);
-
-          std::vector<double> classification;
-          for (size_t j = 0; j < centers.size(); ++j) {
-              if(i==j) classification.push_back(1);
-              else classification.push_back(0);
-          }
-          this->outputData.push_back(classification);
-      }
+  if (this->trainStream) {
+    enableNetwork();
+    ui->outputText->append("Network created for the loaded dataset");
+    return;
   }
-  this->shuffleAndSplitData();
+
+  generateSamples(std::random_device{}());
   enableNetwork();
   ui->outputText->append("Network and sample data created");
 }
 
-void PerceptronWindow::shuffleAndSplitData() {
-    std::vector<size_t> indexes(inputData.size());
-    std::iota(std::begin(indexes), std::end(indexes), 0);
-    std::random_shuffle(std::begin(indexes), std::end(indexes));
+void PerceptronWindow::generateSamples(uint64_t seed) {
+  NeuralNetwork::ClusterSpec spec;
+  spec.classes = static_cast<size_t>(ui->networkClassesBox->value());
+  spec.inputs = static_cast<size_t>(ui->networkInputsBox->value());
+  spec.samples =
+      static_cast<size_t>(ui->networkSamplesBox->value()) * spec.classes;
+  spec.center_range = 1000.0 * static_cast<double>(spec.classes);
+  spec.spread = 3.0;
+  spec.seed = seed;
+  this->sampleSeed = seed;
+  this->samples = NeuralNetwork::ClusterGenerator(spec).generateStore();
+  // only the views are shuffled and split, the samples stay where they are
+  NeuralNetwork::SampleView all(this->samples, seed);
+  all.shuffle();
+  std::tie(this->trainSamples, this->testSamples) =
+      all.split(ui->networkSplitRatioBox->value());
+  this->trainSamples.setShuffleEachEpoch(true);
+}
 
-    std::vector<std::vector<double>> oldInputData;
-    std::vector<std::vector<double>> oldOutputData;
-    std::copy(std::begin(inputData), std::end(inputData), std::back_inserter(oldInputData));
-    std::copy(std::begin(outputData), std::end(outputData), std::back_inserter(oldOutputData));
+// "clusters <classes> <inputs> <samples per class> <split> <seed>" or
+// "dataset <split> <path>"
+QString PerceptronWindow::samplesDescription() const {
+  const QString split =
+      QString::number(ui->networkSplitRatioBox->value(), 'g', 17);
+  if (!this->datasetPath.isEmpty()) {
+    return QString("dataset %1 %2").arg(split, this->datasetPath);
+  }
+  return QString("clusters %1 %2 %3 %4 %5")
+      .arg(ui->networkClassesBox->value())
+      .arg(ui->networkInputsBox->value())
+      .arg(ui->networkSamplesBox->value())
+      .arg(split)
+      .arg(this->sampleSeed);
+}
 
-    for (size_t i = 0; i < indexes.size(); ++i) {
-        inputData.at(i) = oldInputData.at(indexes.at(i));
-        outputData.at(i) = oldOutputData.at(indexes.at(i));
+void PerceptronWindow::on_networkResumeButton_clicked() {
+  QString path = QFileDialog::getOpenFileName(this, "Resume training",
+                                              QString(), "Checkpoints (*.nnc)");
+  if (path.isEmpty()) return;
+  NeuralNetwork::TrainingState state;
+  try {
+    state = NeuralNetwork::Checkpoint::load(path.toStdString());
+  } catch (const std::exception& e) {
+    ui->outputText->append(QString("Cannot resume: %1").arg(e.what()));
+    return;
+  }
+  const QStringList words =
+      QString::fromStdString(state.description).split(' ');
+  const bool dataset = words.size() >= 3 && words[0] == "dataset";
+  if (!dataset && (words.size() != 6 || words[0] != "clusters")) {
+    ui->outputText->append("Cannot resume: the checkpoint does not tell "
+                           "where its samples came from");
+    return;
+  }
+  ui->networkInputsBox->setValue(
+      static_cast<int>(state.weights.front().cols()));
+  ui->networkClassesBox->setValue(
+      static_cast<int>(state.weights.back().rows()));
+  ui->networkBetaBox->setValue(state.parameters.beta);
+  ui->networkThetaBox->setValue(state.parameters.theta);
+  ui->networkIterationsBox->setValue(static_cast<int>(state.epochs));
+  ui->networkOptimizerBox->setCurrentIndex(
+      static_cast<int>(state.optimizer.method));
+  disableNetwork();
+  this->trainStream.reset();
+  this->testStream.reset();
+  try {
+    if (dataset) {
+      ui->networkSplitRatioBox->setValue(words[1].toDouble());
+      this->datasetPath = QString::fromStdString(state.description)
+                              .section(' ', 2);
+      openDatasetStreams();
+    } else {
+      this->datasetPath.clear();
+      ui->networkSamplesBox->setValue(words[3].toInt());
+      ui->networkSplitRatioBox->setValue(words[4].toDouble());
+      generateSamples(words[5].toULongLong());
     }
-
-    auto split_offset = static_cast<long long>(std::round(
-                                                   std::distance(std::begin(inputData), std::end(inputData))
-                                                   * ui->networkSplitRatioBox->value()));
-
-    inputTrain.clear();
-    inputTest.clear();
-    outputTrain.clear();
-    outputTest.clear();
-    std::copy(std::begin(inputData), std::begin(inputData) + split_offset, std::back_inserter(inputTrain));
-    std::copy(std::begin(inputData) + split_offset, std::end(inputData), std::back_inserter(inputTest));
-    std::copy(std::begin(outputData), std::begin(outputData) + split_offset, std::back_inserter(outputTrain));
-    std::copy(std::begin(outputData) + split_offset, std::end(outputData), std::back_inserter(outputTest));
+  } catch (const std::exception& e) {
+    this->datasetPath.clear();
+    ui->outputText->append(QString("Cannot resume: %1").arg(e.what()));
+    return;
+  }
+  const size_t epoch = state.epoch;
+  this->network = NeuralNetwork::Checkpoint::resume(std::move(state));
+  enableNetwork();
+  ui->outputText->append(QString("Resumed %1 after epoch %2 of %3, train to "
+                                 "continue")
+                             .arg(path)
+                             .arg(epoch)
+                             .arg(ui->networkIterationsBox->value()));
 }
@@ -3,16 +3,24 @@
 
 #include <QDoubleSpinBox>
 #include <QMainWindow>
+#include <QPointF>
 #include <QTableWidget>
 #include <QValueAxis>
+#include <QVector>
 #include <QtCharts/QChartView>
 #include <QtCharts/QLineSeries>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <climits>
 #include <functional>
 #include <random>
 #include <string>
+#include <thread>
 #include <tuple>
+#include "checkpoint.h"
+#include "decimator.h"
+#include "evaluation.h"
 #include "network.h"
 #include "neuron.h"
 
@@ -48,28 +56,80 @@ class PerceptronWindow : public QMainWindow {
 
   void on_networkCreateButton_clicked();
 
+  void on_networkCancelButton_clicked();
+
+  void on_networkLoadButton_clicked();
+
+  void on_networkResumeButton_clicked();
+
  private:
   Ui::PerceptronWindow *ui;
   QtCharts::QChart *sigmoidChart;
+  // the curve is one series whose points are replaced on every change
+  QtCharts::QLineSeries *sigmoidSeries;
+  QtCharts::QValueAxis *sigmoidInputAxis;
+  QtCharts::QValueAxis *sigmoidOutputAxis;
   const double sigmoidPlotOffset{5};
   const size_t sigmoidPlotPoints{1000};
+  // steepness of the single neuron's logistic function, networks keep their
+  // own
+  double neuronBeta{1.0};
   std::unique_ptr<NeuralNetwork::NeuralNetwork> network{nullptr};
 
+  // training runs on its own thread, the epoch reports are posted back to
+  // the window at most once per progressInterval. The thread records the
+  // loss of every epoch min/max decimated into lossPlotBuckets buckets and
+  // posts the decimated curves, which replace the points of the series.
+  QtCharts::QChart *lossChart;
+  QtCharts::QLineSeries *lossSeries;
+  QtCharts::QLineSeries *validationSeries;
+  QtCharts::QValueAxis *lossEpochAxis;
+  QtCharts::QValueAxis *lossValueAxis;
+  const std::chrono::milliseconds progressInterval{50};
+  const size_t lossPlotBuckets{1000};
+  std::thread trainingThread;
+  std::atomic<bool> trainingCancelled{false};
+  void addEpochPoint(const NeuralNetwork::EpochReport &report,
+                     const QVector<QPointF> &loss,
+                     const QVector<QPointF> &validation);
+  void finishTraining(const NeuralNetwork::EpochReport &report,
+                      const QVector<QPointF> &loss,
+                      const QVector<QPointF> &validation);
+  void setTrainingActive(bool active);
+  // per-layer timings of the last training, written next to a Chrome trace
+  void showProfile();
+
   QDoubleSpinBox *createNumberCell();
   QDoubleSpinBox *createInputCell();
   QDoubleSpinBox *createWeightCell();
   QMap<QString, std::function<double(double)>> perceptronFunctions;
   std::tuple<std::vector<double>, std::vector<double>> getInputVectors();
   void addTrainingPoint(double value);
-  void shuffleAndSplitData();
-
-  std::vector<std::vector<double>> inputData;
-  std::vector<std::vector<double>> outputData;
-
-  std::vector<std::vector<double>> inputTrain;
-  std::vector<std::vector<double>> inputTest;
-  std::vector<std::vector<double>> outputTrain;
-  std::vector<std::vector<double>> outputTest;
+  // generates the samples from seed and splits them, equal seeds and boxes
+  // give equal training and test sets
+  void generateSamples(uint64_t seed);
+  uint64_t sampleSeed{0};
+
+  // a dataset loaded from disk is streamed in batches instead of being
+  // generated into the vectors below
+  QString datasetPath;
+  const size_t datasetBatchSize{256};
+  std::unique_ptr<NeuralNetwork::BatchStream> trainStream;
+  std::unique_ptr<NeuralNetwork::BatchStream> testStream;
+  void openDatasetStreams();
+
+  NeuralNetwork::Evaluator evaluator;
+
+  // written in the background while training when checkpoints are enabled,
+  // the description tells a resume how to recreate the samples
+  const char *checkpointFile{"training.nnc"};
+  const std::chrono::seconds checkpointSpacing{10};
+  std::shared_ptr<NeuralNetwork::CheckpointWriter> checkpointWriter;
+  QString samplesDescription() const;
+
+  std::shared_ptr<const NeuralNetwork::SampleStore> samples;
+  NeuralNetwork::SampleView trainSamples;
+  NeuralNetwork::SampleView testSamples;
 };
 
 #endif  // PERCEPTRONWINDOW_H
@@ -0,0 +1,243 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Event {
+  const char *name;
+  int layer;
+  uint64_t begin_ns;
+  uint64_t duration_ns;
+  uint64_t flops;
+  uint64_t bytes;
+};
+
+struct Total {
+  const char *name;
+  int layer;
+  uint64_t calls;
+  uint64_t duration_ns;
+  uint64_t flops;
+  uint64_t bytes;
+  uint64_t allocations;
+};
+
+// The mutex is only contended while an export reads the log.
+struct ThreadLog {
+  std::mutex mutex;
+  size_t thread_index{0};
+  std::vector<Event> events;
+  std::vector<Total> totals;
+};
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<ThreadLog>> logs;
+  std::atomic<bool> enabled{true};
+  std::atomic<size_t> trace_limit{size_t{1} << 18};
+  const Clock::time_point origin{Clock::now()};
+};
+
+Registry &registry() {
+  static Registry instance;
+  return instance;
+}
+
+// logs outlive their threads, pool workers come and go
+ThreadLog &threadLog() {
+  thread_local std::shared_ptr<ThreadLog> log = [] {
+    auto created = std::make_shared<ThreadLog>();
+    Registry &shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    created->thread_index = shared.logs.size();
+    shared.logs.push_back(created);
+    return created;
+  }();
+  return *log;
+}
+
+std::atomic<uint64_t> allocationCount{0};
+thread_local uint64_t threadAllocations = 0;
+
+bool sameScope(const Total &total, const char *name, int layer) {
+  return total.layer == layer &&
+         (total.name == name || std::strcmp(total.name, name) == 0);
+}
+
+uint64_t nanoseconds(Clock::duration duration) {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+}
+}  // namespace
+
+#ifdef NEURALNETWORK_PROFILING
+// counts every heap allocation of the process, per thread and in total
+void *operator new(size_t size) {
+  ++threadAllocations;
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  if (void *block = std::malloc(size ? size : 1)) return block;
+  throw std::bad_alloc();
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *block) noexcept { std::free(block); }
+void operator delete[](void *block) noexcept { std::free(block); }
+void operator delete(void *block, size_t) noexcept { std::free(block); }
+void operator delete[](void *block, size_t) noexcept { std::free(block); }
+#endif
+
+NeuralNetwork::Profiling::Scope::Scope(const char *name, int layer,
+                                       uint64_t flops, uint64_t bytes)
+    : name(registry().enabled.load(std::memory_order_relaxed) ? name
+                                                              : nullptr),
+      layer(layer),
+      flops(flops),
+      bytes(bytes),
+      allocations(threadAllocations),
+      start(Clock::now()) {}
+
+NeuralNetwork::Profiling::Scope::~Scope() {
+  if (!name) return;
+  const Clock::time_point end = Clock::now();
+  const uint64_t allocated = threadAllocations - allocations;
+  ThreadLog &log = threadLog();
+  std::lock_guard<std::mutex> lock(log.mutex);
+  auto total = std::find_if(
+      log.totals.begin(), log.totals.end(),
+      [this](const Total &entry) { return sameScope(entry, name, layer); });
+  if (total == log.totals.end()) {
+    log.totals.push_back({name, layer, 0, 0, 0, 0, 0});
+    total = log.totals.end() - 1;
+  }
+  const uint64_t duration = nanoseconds(end - start);
+  ++total->calls;
+  total->duration_ns += duration;
+  total->flops += flops;
+  total->bytes += bytes;
+  total->allocations += allocated;
+  if (log.events.size() < registry().trace_limit.load()) {
+    log.events.push_back({name, layer, nanoseconds(start - registry().origin),
+                          duration, flops, bytes});
+  }
+  // the log's own growth is not charged to the enclosing scopes
+  threadAllocations = allocations + allocated;
+}
+
+void NeuralNetwork::Profiling::setEnabled(bool enabled) {
+  registry().enabled = enabled;
+}
+
+void NeuralNetwork::Profiling::setTraceLimit(size_t events) {
+  registry().trace_limit = events;
+}
+
+void NeuralNetwork::Profiling::reset() {
+  Registry &shared = registry();
+  std::lock_guard<std::mutex> lock(shared.mutex);
+  for (auto &log : shared.logs) {
+    std::lock_guard<std::mutex> log_lock(log->mutex);
+    log->events.clear();
+    log->totals.clear();
+  }
+}
+
+uint64_t NeuralNetwork::Profiling::allocations() {
+  return allocationCount.load(std::memory_order_relaxed);
+}
+
+std::string NeuralNetwork::Profiling::summary() {
+  std::vector<Total> totals;
+  {
+    Registry &shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    for (auto &log : shared.logs) {
+      std::lock_guard<std::mutex> log_lock(log->mutex);
+      for (const Total &entry : log->totals) {
+        auto total = std::find_if(totals.begin(), totals.end(),
+                                  [&entry](const Total &other) {
+                                    return sameScope(other, entry.name,
+                                                     entry.layer);
+                                  });
+        if (total == totals.end()) {
+          totals.push_back(entry);
+          continue;
+        }
+        total->calls += entry.calls;
+        total->duration_ns += entry.duration_ns;
+        total->flops += entry.flops;
+        total->bytes += entry.bytes;
+        total->allocations += entry.allocations;
+      }
+    }
+  }
+  std::sort(totals.begin(), totals.end(), [](const Total &a, const Total &b) {
+    const int order = std::strcmp(a.name, b.name);
+    return order ? order < 0 : a.layer < b.layer;
+  });
+
+  std::string text;
+  char line[160];
+  std::snprintf(line, sizeof(line), "%-12s %5s %10s %12s %10s %9s %9s %10s\n",
+                "scope", "layer", "calls", "total ms", "mean us", "GFLOP/s",
+                "GB/s", "allocs");
+  text += line;
+  for (const Total &total : totals) {
+    const double seconds = static_cast<double>(total.duration_ns) * 1e-9;
+    const double rate = seconds > 0.0 ? 1e-9 / seconds : 0.0;
+    char layer[16] = "-";
+    if (total.layer >= 0) std::snprintf(layer, sizeof(layer), "%d", total.layer);
+    std::snprintf(line, sizeof(line),
+                  "%-12s %5s %10llu %12.3f %10.3f %9.3f %9.3f %10llu\n",
+                  total.name, layer,
+                  static_cast<unsigned long long>(total.calls), seconds * 1e3,
+                  seconds * 1e6 / static_cast<double>(total.calls),
+                  static_cast<double>(total.flops) * rate,
+                  static_cast<double>(total.bytes) * rate,
+                  static_cast<unsigned long long>(total.allocations));
+    text += line;
+  }
+  return text;
+}
+
+std::string NeuralNetwork::Profiling::chromeTrace() {
+  std::string json = "{\"traceEvents\":[";
+  bool first = true;
+  char line[320];
+  Registry &shared = registry();
+  std::lock_guard<std::mutex> lock(shared.mutex);
+  for (auto &log : shared.logs) {
+    std::lock_guard<std::mutex> log_lock(log->mutex);
+    for (const Event &event : log->events) {
+      std::snprintf(
+          line, sizeof(line),
+          "%s\n{\"name\":\"%s\",\"cat\":\"network\",\"ph\":\"X\",\"pid\":1,"
+          "\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"layer\":%d,"
+          "\"flops\":%llu,\"bytes\":%llu}}",
+          first ? "" : ",", event.name, log->thread_index,
+          static_cast<double>(event.begin_ns) * 1e-3,
+          static_cast<double>(event.duration_ns) * 1e-3, event.layer,
+          static_cast<unsigned long long>(event.flops),
+          static_cast<unsigned long long>(event.bytes));
+      json += line;
+      first = false;
+    }
+  }
+  json += "\n],\"displayTimeUnit\":\"ns\"}\n";
+  return json;
+}
+
+bool NeuralNetwork::Profiling::writeChromeTrace(const std::string &path) {
+  std::ofstream out(path, std::ios::trunc);
+  out << chromeTrace();
+  return static_cast<bool>(out);
+}
@@ -0,0 +1,66 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+#include <chrono>
+#include <cstdint>
+#include <string>
+// Opt-in instrumentation of the network hot paths. Building with
+// NEURALNETWORK_PROFILING defined (CONFIG += profiling with qmake) turns the
+// NN_PROFILE_SCOPE markers into timers that record per-layer wall time,
+// floating point operations, bytes moved and heap allocations. Without it
+// the markers expand to nothing and no code is left behind.
+//
+// Every thread records into its own buffer, the totals can be exported as
+// a summary table or as a Chrome trace (chrome://tracing, Perfetto).
+namespace NeuralNetwork {
+namespace Profiling {
+#ifdef NEURALNETWORK_PROFILING
+constexpr bool available = true;
+#else
+constexpr bool available = false;
+#endif
+
+// Times the enclosing block. name must be a string literal, layer is -1
+// for scopes not tied to a layer.
+class Scope {
+ public:
+  Scope(const char *name, int layer = -1, uint64_t flops = 0,
+        uint64_t bytes = 0);
+  ~Scope();
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+ private:
+  const char *name;
+  int layer;
+  uint64_t flops;
+  uint64_t bytes;
+  uint64_t allocations;
+  std::chrono::steady_clock::time_point start;
+};
+
+// recording can also be paused at run time, it starts enabled
+void setEnabled(bool enabled);
+// trace events kept per thread, later scopes only count towards the totals
+void setTraceLimit(size_t events);
+// drops everything recorded so far
+void reset();
+// heap allocations made by the process since it started
+uint64_t allocations();
+// one line per scope and layer: calls, time, GFLOP/s, GB/s, allocations
+std::string summary();
+std::string chromeTrace();
+// false if the file cannot be written
+bool writeChromeTrace(const std::string &path);
+}  // namespace Profiling
+}  // namespace NeuralNetwork
+
+#define NN_PROFILE_CONCAT_(a, b) a##b
+#define NN_PROFILE_CONCAT(a, b) NN_PROFILE_CONCAT_(a, b)
+#ifdef NEURALNETWORK_PROFILING
+#define NN_PROFILE_SCOPE(...)                             \
+  ::NeuralNetwork::Profiling::Scope NN_PROFILE_CONCAT( \
+      nn_profile_scope_, __LINE__)(__VA_ARGS__)
+#else
+#define NN_PROFILE_SCOPE(...) static_cast<void>(0)
+#endif
+#endif  // PROFILER_H
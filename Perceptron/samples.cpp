@@ -0,0 +1,89 @@
+#include "samples.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+NeuralNetwork::SampleView::SampleView(std::shared_ptr<const SampleStore> store,
+                                      uint64_t seed)
+    : store(std::move(store)), engine(seed) {
+  indices.resize(this->store ? this->store->size() : 0);
+  std::iota(indices.begin(), indices.end(), size_t{0});
+}
+
+NeuralNetwork::SampleView::SampleView(std::shared_ptr<const SampleStore> store,
+                                      std::vector<size_t> indices,
+                                      uint64_t seed)
+    : store(std::move(store)), indices(std::move(indices)), engine(seed) {
+  const size_t size = this->store ? this->store->size() : 0;
+  if (std::any_of(this->indices.begin(), this->indices.end(),
+                  [size](size_t index) { return index >= size; })) {
+    throw std::out_of_range("sample index outside of the store");
+  }
+}
+
+void NeuralNetwork::SampleView::shuffle() {
+  std::shuffle(indices.begin(), indices.end(), engine);
+}
+
+std::string NeuralNetwork::SampleView::engineState() const {
+  std::ostringstream state;
+  state << engine;
+  return state.str();
+}
+
+void NeuralNetwork::SampleView::restore(std::vector<size_t> order,
+                                        const std::string &engine_state) {
+  const size_t size = store ? store->size() : 0;
+  if (order.size() != indices.size() ||
+      std::any_of(order.begin(), order.end(),
+                  [size](size_t index) { return index >= size; })) {
+    throw std::invalid_argument("sample order does not match the view");
+  }
+  std::mt19937_64 restored;
+  std::istringstream state(engine_state);
+  state >> restored;
+  if (!state) throw std::invalid_argument("bad sample engine state");
+  indices = std::move(order);
+  engine = restored;
+}
+
+// the parts draw their seeds from this view so that a seeded view splits
+// reproducibly
+std::pair<NeuralNetwork::SampleView, NeuralNetwork::SampleView>
+NeuralNetwork::SampleView::split(double ratio) const {
+  const auto offset = static_cast<std::ptrdiff_t>(std::round(
+      static_cast<double>(indices.size()) * std::min(std::max(ratio, 0.0), 1.0)));
+  std::mt19937_64 seeds(engine);
+  SampleView first(store, {indices.begin(), indices.begin() + offset},
+                   seeds());
+  SampleView second(store, {indices.begin() + offset, indices.end()}, seeds());
+  return {std::move(first), std::move(second)};
+}
+
+std::pair<NeuralNetwork::SampleView, NeuralNetwork::SampleView>
+NeuralNetwork::SampleView::fold(size_t fold, size_t folds) const {
+  if (!folds || fold >= folds) {
+    throw std::invalid_argument("fold outside of the folds");
+  }
+  const size_t begin = indices.size() * fold / folds;
+  const size_t end = indices.size() * (fold + 1) / folds;
+  std::vector<size_t> training;
+  training.reserve(indices.size() - (end - begin));
+  training.insert(training.end(), indices.begin(),
+                  indices.begin() + static_cast<std::ptrdiff_t>(begin));
+  training.insert(training.end(),
+                  indices.begin() + static_cast<std::ptrdiff_t>(end),
+                  indices.end());
+  std::mt19937_64 seeds(engine);
+  seeds.discard(2 * fold);
+  SampleView train(store, std::move(training), seeds());
+  SampleView validation(
+      store,
+      {indices.begin() + static_cast<std::ptrdiff_t>(begin),
+       indices.begin() + static_cast<std::ptrdiff_t>(end)},
+      seeds());
+  return {std::move(train), std::move(validation)};
+}
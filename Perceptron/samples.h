@@ -0,0 +1,74 @@
+#ifndef SAMPLES_H
+#define SAMPLES_H
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "matrix.h"
+namespace NeuralNetwork {
+// Samples kept once in two contiguous matrices, row i of inputs and outputs
+// forming sample i.
+struct SampleStore {
+  SampleStore() = default;
+  SampleStore(size_t samples, size_t input_count, size_t output_count)
+      : inputs(samples, input_count), outputs(samples, output_count) {}
+  size_t size() const { return inputs.rows(); }
+
+  Matrix inputs;
+  Matrix outputs;
+};
+
+// Ordered selection of the samples of a store. Views only hold indices into
+// the shared store, so shuffling, splitting and folding never copy sample
+// data and any number of views may share one store.
+class SampleView {
+ public:
+  SampleView() = default;
+  // every sample of the store in stored order
+  explicit SampleView(std::shared_ptr<const SampleStore> store,
+                      uint64_t seed = std::random_device{}());
+  SampleView(std::shared_ptr<const SampleStore> store,
+             std::vector<size_t> indices,
+             uint64_t seed = std::random_device{}());
+
+  size_t size() const { return indices.size(); }
+  bool empty() const { return indices.empty(); }
+  size_t inputCount() const { return store ? store->inputs.cols() : 0; }
+  size_t outputCount() const { return store ? store->outputs.cols() : 0; }
+  const double *input(size_t i) const { return store->inputs.row(indices[i]); }
+  const double *output(size_t i) const {
+    return store->outputs.row(indices[i]);
+  }
+
+  // permutes the order of the view, the store is untouched
+  void shuffle();
+  // reshuffle at the start of every training epoch
+  void setShuffleEachEpoch(bool enabled) { shuffle_each_epoch = enabled; }
+  // called by NeuralNetwork::train before every epoch
+  void beginEpoch() {
+    if (shuffle_each_epoch) shuffle();
+  }
+
+  // order and shuffle engine, what a checkpoint keeps of a view
+  const std::vector<size_t> &order() const { return indices; }
+  std::string engineState() const;
+  // puts back the order and engine state of a view of as many samples from
+  // the same store
+  void restore(std::vector<size_t> order, const std::string &engine_state);
+
+  // the first round(ratio * size()) samples and the rest
+  std::pair<SampleView, SampleView> split(double ratio) const;
+  // fold of folds equally sized parts as validation, everything else as
+  // training samples
+  std::pair<SampleView, SampleView> fold(size_t fold, size_t folds) const;
+
+ private:
+  std::shared_ptr<const SampleStore> store;
+  std::vector<size_t> indices;
+  std::mt19937_64 engine;
+  bool shuffle_each_epoch{false};
+};
+}  // namespace NeuralNetwork
+#endif  // SAMPLES_H
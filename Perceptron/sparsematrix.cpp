@@ -0,0 +1,67 @@
+#include "sparsematrix.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "kernels.h"
+
+void NeuralNetwork::SparseMatrix::assign(const Matrix &dense) {
+  const size_t count = dense.size() - static_cast<size_t>(std::count(
+                                          dense.begin(), dense.end(), 0.0));
+  if (dense.cols() > std::numeric_limits<uint32_t>::max() ||
+      count > std::numeric_limits<uint32_t>::max()) {
+    throw std::invalid_argument("matrix too large for 32 bit sparse indices");
+  }
+  row_count = dense.rows();
+  col_count = dense.cols();
+  values.clear();
+  columns.clear();
+  values.reserve(count);
+  columns.reserve(count);
+  row_starts.assign(1, 0);
+  for (size_t i = 0; i < row_count; ++i) {
+    const double *row = dense.row(i);
+    for (size_t k = 0; k < col_count; ++k) {
+      if (row[k] == 0.0) continue;
+      values.push_back(row[k]);
+      columns.push_back(static_cast<uint32_t>(k));
+    }
+    row_starts.push_back(static_cast<uint32_t>(values.size()));
+  }
+}
+
+void NeuralNetwork::SparseMatrix::clear() {
+  row_count = 0;
+  col_count = 0;
+  values.clear();
+  columns.clear();
+  row_starts.clear();
+}
+
+size_t NeuralNetwork::SparseMatrix::bytes() const {
+  return values.size() * sizeof(double) + columns.size() * sizeof(uint32_t) +
+         row_starts.size() * sizeof(uint32_t);
+}
+
+void NeuralNetwork::SparseMatrix::multiply(const double *input,
+                                           double *output) const {
+  for (size_t i = 0; i < row_count; ++i) {
+    const uint32_t first = row_starts[i];
+    output[i] = Neuron::Kernels::gatherDot(values.data() + first,
+                                           columns.data() + first,
+                                           row_starts[i + 1] - first, input);
+  }
+}
+
+void NeuralNetwork::SparseMatrix::multiplyTransposed(const Matrix &a,
+                                                     Matrix &c) const {
+  c.resize(a.rows(), row_count);
+  for (size_t r = 0; r < a.rows(); ++r) multiply(a.row(r), c.row(r));
+}
+
+double NeuralNetwork::SparseMatrix::density(const Matrix &dense) {
+  if (!dense.size()) return 0.0;
+  const auto zeros = std::count(dense.begin(), dense.end(), 0.0);
+  return 1.0 - static_cast<double>(zeros) / static_cast<double>(dense.size());
+}
@@ -0,0 +1,196 @@
+#ifndef STATICNETWORK_H
+#define STATICNETWORK_H
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "activation.h"
+#include "network.h"
+namespace NeuralNetwork {
+namespace Static {
+// the Index-th of Sizes
+template <size_t Index, size_t First, size_t... Rest>
+struct SizeAt : SizeAt<Index - 1, Rest...> {};
+template <size_t First, size_t... Rest>
+struct SizeAt<0, First, Rest...> : std::integral_constant<size_t, First> {};
+
+// Links an activation policy to the runtime activation it replaces. Custom
+// activations have no static counterpart.
+template <typename Policy>
+struct ActivationOf {
+  static_assert(sizeof(Policy) == 0,
+                "static networks need a built in activation policy");
+};
+template <>
+struct ActivationOf<Neuron::Policy::Heaviside> {
+  static constexpr Neuron::Activation value = Neuron::Activation::Heaviside;
+  static Neuron::Policy::Heaviside policy(
+      const Neuron::ActivationParameters &parameters) {
+    return {parameters.theta};
+  }
+};
+template <>
+struct ActivationOf<Neuron::Policy::Sign> {
+  static constexpr Neuron::Activation value = Neuron::Activation::Sign;
+  static Neuron::Policy::Sign policy(
+      const Neuron::ActivationParameters &parameters) {
+    return {parameters.theta};
+  }
+};
+template <>
+struct ActivationOf<Neuron::Policy::Logistic> {
+  static constexpr Neuron::Activation value = Neuron::Activation::Logistic;
+  static Neuron::Policy::Logistic policy(
+      const Neuron::ActivationParameters &parameters) {
+    return {parameters.beta, parameters.theta};
+  }
+};
+template <>
+struct ActivationOf<Neuron::Policy::Tanh> {
+  static constexpr Neuron::Activation value = Neuron::Activation::Tanh;
+  static Neuron::Policy::Tanh policy(
+      const Neuron::ActivationParameters &parameters) {
+    return {parameters.theta};
+  }
+};
+
+// Cols inputs to Rows neurons. The weights are kept input-major, so the
+// inner loop runs across the neurons and vectorizes without reordering any
+// sum.
+template <size_t Rows, size_t Cols>
+struct Layer {
+  alignas(64) std::array<double, Rows * Cols> weights;
+};
+}  // namespace Static
+
+// Inference-only copy of a trained network whose topology is fixed at
+// compile time, e.g. StaticNetwork<Neuron::Policy::Logistic, 8, 16, 16, 4>
+// for 8 inputs, two hidden layers of 16 neurons and 4 outputs. Weights and
+// intermediate values live in std::array, every loop bound is a constant and
+// the layers are chained by templates, so the compiler can unroll the whole
+// forward pass and inline the activation. simulate() is const, never
+// allocates and can be called from any number of threads.
+template <typename Activation, size_t... Sizes>
+class StaticNetwork {
+  static_assert(sizeof...(Sizes) >= 2,
+                "a network needs at least an input and an output size");
+
+ public:
+  static constexpr size_t layer_count = sizeof...(Sizes) - 1;
+  static constexpr size_t input_count = Static::SizeAt<0, Sizes...>::value;
+  static constexpr size_t output_count =
+      Static::SizeAt<layer_count, Sizes...>::value;
+  using Input = std::array<double, input_count>;
+  using Output = std::array<double, output_count>;
+
+  // Copies the weights of network, throws std::invalid_argument unless its
+  // layers and activation match this type.
+  explicit StaticNetwork(const NeuralNetwork &network)
+      : policy(Static::ActivationOf<Activation>::policy(
+            network.activationParameters())) {
+    if (network.activationFunction() != Static::ActivationOf<Activation>::value) {
+      throw std::invalid_argument("network uses another activation");
+    }
+    if (network.layerCount() != layer_count) {
+      throw std::invalid_argument("network has another number of layers");
+    }
+    load(network, std::make_index_sequence<layer_count>());
+  }
+
+  void simulate(const double *input, double *output) const {
+    forward<0>(input, output);
+  }
+  Output simulate(const Input &input) const {
+    Output output;
+    forward<0>(input.data(), output.data());
+    return output;
+  }
+
+ private:
+  template <size_t L>
+  using Rows = Static::SizeAt<L + 1, Sizes...>;
+  template <size_t L>
+  using Cols = Static::SizeAt<L, Sizes...>;
+  // neurons summed at once, sized for the vector registers of x86-64
+  static constexpr size_t block_width = 8;
+  template <typename Indices>
+  struct LayersOf;
+  template <size_t... L>
+  struct LayersOf<std::index_sequence<L...>> {
+    using type = std::tuple<Static::Layer<Rows<L>::value, Cols<L>::value>...>;
+  };
+
+  template <size_t... L>
+  void load(const NeuralNetwork &network, std::index_sequence<L...>) {
+    // expands loadLayer for every layer in order
+    const bool loaded[] = {(loadLayer<L>(network.layerWeights(L)), true)...};
+    static_cast<void>(loaded);
+  }
+
+  template <size_t L>
+  void loadLayer(const Matrix &source) {
+    constexpr size_t rows = Rows<L>::value;
+    constexpr size_t cols = Cols<L>::value;
+    if (source.rows() != rows || source.cols() != cols) {
+      throw std::invalid_argument("network layer has another shape");
+    }
+    auto &weights = std::get<L>(layers).weights;
+    for (size_t i = 0; i < rows; ++i) {
+      for (size_t k = 0; k < cols; ++k) weights[k * rows + i] = source(i, k);
+    }
+  }
+
+  // Sums the neurons first + J. The pack expansions unroll the block, which
+  // keeps its sums in registers across the whole input.
+  template <size_t Rows, size_t Cols, size_t... J>
+  static void sumBlock(const double *weights, size_t first, const double *input,
+                       double *sums, std::index_sequence<J...>) {
+    double block[] = {(static_cast<void>(J), 0.0)...};
+    for (size_t k = 0; k < Cols; ++k) {
+      const double value = input[k];
+      const double *row = weights + k * Rows + first;
+      const bool unrolled[] = {(block[J] += row[J] * value, true)...};
+      static_cast<void>(unrolled);
+    }
+    const bool stored[] = {(sums[first + J] = block[J], true)...};
+    static_cast<void>(stored);
+  }
+
+  template <size_t L>
+  void propagate(const double *input, double *output) const {
+    constexpr size_t rows = Rows<L>::value;
+    constexpr size_t cols = Cols<L>::value;
+    constexpr size_t tail = rows % block_width;
+    const double *weights = std::get<L>(layers).weights.data();
+    std::array<double, rows> sums;
+    for (size_t first = 0; first + block_width <= rows; first += block_width) {
+      sumBlock<rows, cols>(weights, first, input, sums.data(),
+                           std::make_index_sequence<block_width>());
+    }
+    if (tail) {
+      sumBlock<rows, cols>(weights, rows - tail, input, sums.data(),
+                           std::make_index_sequence<tail ? tail : 1>());
+    }
+    policy.activate(sums.data(), output, rows);
+  }
+
+  template <size_t L>
+  std::enable_if_t<L + 1 == layer_count> forward(const double *input,
+                                                 double *output) const {
+    propagate<L>(input, output);
+  }
+  template <size_t L>
+  std::enable_if_t<(L + 1 < layer_count)> forward(const double *input,
+                                                  double *output) const {
+    std::array<double, Rows<L>::value> hidden;
+    propagate<L>(input, hidden.data());
+    forward<L + 1>(hidden.data(), output);
+  }
+
+  typename LayersOf<std::make_index_sequence<layer_count>>::type layers;
+  Activation policy;
+};
+}  // namespace NeuralNetwork
+#endif  // STATICNETWORK_H
@@ -0,0 +1,245 @@
+#include "sweep.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+
+namespace {
+// uniform in log space between the extremes of values
+double logUniform(const std::vector<double> &values, std::mt19937_64 &engine) {
+  const auto range = std::minmax_element(values.begin(), values.end());
+  if (*range.first <= 0.0 || *range.first == *range.second) {
+    return values[std::uniform_int_distribution<size_t>(
+        0, values.size() - 1)(engine)];
+  }
+  std::uniform_real_distribution<double> exponent(std::log(*range.first),
+                                                  std::log(*range.second));
+  return std::exp(exponent(engine));
+}
+
+template <typename T>
+const T &pick(const std::vector<T> &values, std::mt19937_64 &engine) {
+  return values[std::uniform_int_distribution<size_t>(0, values.size() - 1)(
+      engine)];
+}
+
+// whether the training finished with a comparable error
+bool ranked(const NeuralNetwork::SweepResult &result) {
+  return result.error.empty() &&
+         !std::isnan(result.validation.mean_squared_error);
+}
+
+// lower validation error first, accuracy breaks ties. Failed and diverged
+// trainings compare equal to each other and rank last, comparing their NaN
+// errors would break the strict weak order sorting relies on.
+bool ranksBefore(const NeuralNetwork::SweepResult &a,
+                 const NeuralNetwork::SweepResult &b) {
+  if (ranked(a) != ranked(b)) return ranked(a);
+  if (!ranked(a)) return false;
+  if (a.validation.mean_squared_error != b.validation.mean_squared_error) {
+    return a.validation.mean_squared_error < b.validation.mean_squared_error;
+  }
+  return a.validation.accuracy > b.validation.accuracy;
+}
+
+void requireValues(const NeuralNetwork::SearchSpace &space) {
+  if (space.layers.empty() || space.neurons.empty() ||
+      space.activations.empty() || space.betas.empty() ||
+      space.etas.empty() || space.optimizers.empty() ||
+      space.batch_sizes.empty()) {
+    throw std::invalid_argument("every parameter needs at least one value");
+  }
+}
+}  // namespace
+
+// every combination, counted like a mixed-radix number whose last digit is
+// the batch size
+std::vector<NeuralNetwork::Hyperparameters>
+NeuralNetwork::SearchSpace::grid() const {
+  requireValues(*this);
+  const size_t count = layers.size() * neurons.size() * activations.size() *
+                       betas.size() * etas.size() * optimizers.size() *
+                       batch_sizes.size();
+  std::vector<Hyperparameters> points(count);
+  for (size_t p = 0; p < count; ++p) {
+    size_t rest = p;
+    auto digit = [&rest](const auto &values) -> const auto & {
+      const auto &value = values[rest % values.size()];
+      rest /= values.size();
+      return value;
+    };
+    Hyperparameters &point = points[p];
+    point.batch_size = digit(batch_sizes);
+    point.optimizer = digit(optimizers);
+    point.eta = digit(etas);
+    point.beta = digit(betas);
+    point.activation = digit(activations);
+    point.neurons = digit(neurons);
+    point.layers = digit(layers);
+    point.epochs = epochs;
+    point.epsilon = epsilon;
+    point.seed = seed;
+  }
+  return points;
+}
+
+std::vector<NeuralNetwork::Hyperparameters>
+NeuralNetwork::SearchSpace::random(size_t count) const {
+  requireValues(*this);
+  std::mt19937_64 engine(seed);
+  std::vector<Hyperparameters> points(count);
+  for (auto &point : points) {
+    point.layers = pick(layers, engine);
+    point.neurons = pick(neurons, engine);
+    point.activation = pick(activations, engine);
+    point.beta = logUniform(betas, engine);
+    point.eta = logUniform(etas, engine);
+    point.optimizer = pick(optimizers, engine);
+    point.batch_size = pick(batch_sizes, engine);
+    point.epochs = epochs;
+    point.epsilon = epsilon;
+    point.seed = seed;
+  }
+  return points;
+}
+
+NeuralNetwork::Sweep::Sweep(size_t threads)
+    : pool(std::max<size_t>(threads, 1)) {}
+
+void NeuralNetwork::Sweep::cancel() { cancelled = true; }
+
+// The pool hands out the points one at a time, so long and short trainings
+// balance across the threads on their own. Exceptions of a training are
+// caught on its thread and kept in its result.
+std::vector<NeuralNetwork::SweepResult> NeuralNetwork::Sweep::run(
+    const std::vector<Hyperparameters> &points, const SampleView &training,
+    const SampleView &validation, const SweepCallback &on_result) {
+  if (training.inputCount() != validation.inputCount() ||
+      training.outputCount() != validation.outputCount()) {
+    throw std::invalid_argument("training and validation samples differ");
+  }
+  cancelled = false;
+  std::vector<SweepResult> results(points.size());
+  std::vector<char> finished(points.size(), 0);
+  std::mutex report_mutex;
+  size_t done = 0;
+  pool.run(points.size(), [&](size_t p) {
+    if (cancelled) return;
+    const Hyperparameters &point = points[p];
+    const auto start = std::chrono::steady_clock::now();
+    SweepResult &result = results[p];
+    result.parameters = point;
+    try {
+      NeuralNetworkBuilder builder;
+      auto network = builder.setInputNeurons(training.inputCount())
+                         .setOutputNeurons(training.outputCount())
+                         .setIntermediateLayers(point.layers)
+                         .setIntermediateNeurons(point.neurons)
+                         .setActivation(point.activation)
+                         .setBeta(point.beta)
+                         .setSeed(point.seed)
+                         .build();
+      Optimizer optimizer;
+      optimizer.method = point.optimizer;
+      network->setOptimizer(optimizer);
+
+      SampleView samples = training;
+      network->train(samples, point.eta, point.epsilon, point.epochs,
+                     point.batch_size,
+                     [&result, this](const EpochReport &report) {
+                       result.training_loss = report.loss;
+                       result.epochs = report.epoch + 1;
+                       return !cancelled.load();
+                     });
+      if (cancelled) return;
+      Evaluator evaluator(1);
+      result.validation = evaluator.evaluate(*network, validation);
+    } catch (const std::exception &e) {
+      result.error = e.what();
+      if (result.error.empty()) result.error = "training failed";
+    }
+    result.seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+
+    std::lock_guard<std::mutex> lock(report_mutex);
+    finished[p] = 1;
+    ++done;
+    if (on_result && !on_result(result, done, points.size())) cancel();
+  });
+
+  std::vector<SweepResult> ranked;
+  ranked.reserve(done);
+  for (size_t p = 0; p < points.size(); ++p) {
+    if (finished[p]) ranked.push_back(std::move(results[p]));
+  }
+  std::stable_sort(ranked.begin(), ranked.end(), ranksBefore);
+  return ranked;
+}
+
+const char *NeuralNetwork::Sweep::activationName(
+    Neuron::Activation activation) {
+  switch (activation) {
+    case Neuron::Activation::Heaviside:
+      return "heaviside";
+    case Neuron::Activation::Sign:
+      return "sign";
+    case Neuron::Activation::Logistic:
+      return "logistic";
+    case Neuron::Activation::Tanh:
+      return "tanh";
+    case Neuron::Activation::Custom:
+      break;
+  }
+  return "custom";
+}
+
+const char *NeuralNetwork::Sweep::optimizerName(Optimizer::Method method) {
+  switch (method) {
+    case Optimizer::Method::SGD:
+      return "sgd";
+    case Optimizer::Method::Momentum:
+      return "momentum";
+    case Optimizer::Method::Nesterov:
+      return "nesterov";
+    case Optimizer::Method::Adam:
+      return "adam";
+  }
+  return "sgd";
+}
+
+std::string NeuralNetwork::Sweep::table(
+    const std::vector<SweepResult> &results) {
+  std::string text;
+  char line[200];
+  std::snprintf(line, sizeof(line),
+                "%4s %6s %7s %-9s %7s %9s %-8s %5s %6s %10s %10s %8s %8s\n",
+                "rank", "layers", "neurons", "function", "beta", "eta",
+                "optim", "batch", "epochs", "train mse", "valid mse",
+                "accuracy", "seconds");
+  text += line;
+  for (size_t r = 0; r < results.size(); ++r) {
+    const SweepResult &result = results[r];
+    const Hyperparameters &point = result.parameters;
+    std::snprintf(line, sizeof(line),
+                  "%4zu %6zu %7zu %-9s %7.3f %9.5f %-8s %5zu %6zu ", r + 1,
+                  point.layers, point.neurons,
+                  activationName(point.activation), point.beta, point.eta,
+                  optimizerName(point.optimizer), point.batch_size,
+                  result.epochs);
+    text += line;
+    if (!result.error.empty()) {
+      text += "failed: " + result.error + "\n";
+      continue;
+    }
+    std::snprintf(line, sizeof(line), "%10.5f %10.5f %7.2f%% %8.2f\n",
+                  result.training_loss, result.validation.mean_squared_error,
+                  result.validation.accuracy * 100.0, result.seconds);
+    text += line;
+  }
+  return text;
+}
@@ -0,0 +1,95 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "evaluation.h"
+#include "network.h"
+#include "optimizer.h"
+#include "samples.h"
+#include "threadpool.h"
+namespace NeuralNetwork {
+// One point of a search: the builder parameters of a network and how it is
+// trained.
+struct Hyperparameters {
+  size_t layers{1};
+  size_t neurons{8};
+  Neuron::Activation activation{Neuron::Activation::Logistic};
+  double beta{1.0};
+  double eta{0.01};
+  Optimizer::Method optimizer{Optimizer::Method::SGD};
+  size_t batch_size{1};
+  size_t epochs{100};
+  double epsilon{0.0};
+  // initial weights, equal seeds start equal topologies from equal weights
+  uint64_t seed{0};
+};
+
+// Values tried per parameter. grid() combines all of them, random() draws
+// points: the discrete parameters from their lists, eta and beta
+// log-uniformly between the smallest and largest listed value. Both throw
+// std::invalid_argument when a list is empty.
+struct SearchSpace {
+  std::vector<size_t> layers{1};
+  std::vector<size_t> neurons{8};
+  std::vector<Neuron::Activation> activations{Neuron::Activation::Logistic};
+  std::vector<double> betas{1.0};
+  std::vector<double> etas{0.01};
+  std::vector<Optimizer::Method> optimizers{Optimizer::Method::SGD};
+  std::vector<size_t> batch_sizes{1};
+  size_t epochs{100};
+  double epsilon{0.0};
+  uint64_t seed{0};
+
+  std::vector<Hyperparameters> grid() const;
+  std::vector<Hyperparameters> random(size_t count) const;
+};
+
+struct SweepResult {
+  Hyperparameters parameters;
+  // metrics on the validation samples after training
+  Evaluation validation;
+  // mean squared error of the last training epoch
+  double training_loss{0.0};
+  size_t epochs{0};
+  double seconds{0.0};
+  // what the training or evaluation threw, empty if it finished
+  std::string error;
+};
+
+// Called after every finished training with the number of trainings done so
+// far, returning false cancels the trainings that have not finished.
+using SweepCallback =
+    std::function<bool(const SweepResult &result, size_t done, size_t total)>;
+
+// Trains one network per point concurrently, each on its own thread of the
+// pool with a single-threaded network, and evaluates it on the validation
+// samples. All trainings read the same sample store, each through its own
+// copy of the training view. A point whose training throws is reported with
+// its error and does not stop the others. The results come back ranked,
+// lowest validation error first, failed and diverged (NaN) trainings last.
+class Sweep {
+ public:
+  explicit Sweep(size_t threads = std::thread::hardware_concurrency());
+
+  std::vector<SweepResult> run(const std::vector<Hyperparameters> &points,
+                               const SampleView &training,
+                               const SampleView &validation,
+                               const SweepCallback &on_result = nullptr);
+  // asks a running run() to stop, safe to call from any thread
+  void cancel();
+
+  // ranked results as an aligned text table
+  static std::string table(const std::vector<SweepResult> &results);
+  static const char *activationName(Neuron::Activation activation);
+  static const char *optimizerName(Optimizer::Method method);
+
+ private:
+  ThreadPool pool;
+  std::atomic<bool> cancelled{false};
+};
+}  // namespace NeuralNetwork
+#endif  // SWEEP_H
@@ -0,0 +1,216 @@
+// Headless hyperparameter sweep. Loads a dataset once, holds out part of it
+// for validation and trains one network per point of a grid or random
+// search on all cores, then prints the points ranked by validation error.
+//
+//   sweep --data samples.csv --inputs 2 --outputs 3 --layers 1,2
+//         --neurons 8,32 --eta 0.001,0.1 --optimizer sgd,adam --random 40
+//
+// Comma separated lists are combined as a grid unless --random N draws N
+// points, eta and beta then log-uniformly between the listed extremes.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "dataset.h"
+#include "samples.h"
+#include "sweep.h"
+
+namespace {
+struct Options {
+  std::string data;
+  size_t inputs{0};
+  size_t outputs{0};
+  double validation{0.2};
+  size_t random{0};
+  size_t threads{std::max(1u, std::thread::hardware_concurrency())};
+  size_t top{0};
+  std::string format{"table"};
+  NeuralNetwork::SearchSpace space;
+};
+
+std::vector<std::string> split(const char *text) {
+  std::vector<std::string> items;
+  std::stringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) items.push_back(item);
+  }
+  return items;
+}
+
+template <typename T, typename Parse>
+std::vector<T> parseList(const char *text, Parse parse) {
+  std::vector<T> values;
+  for (const auto &item : split(text)) values.push_back(parse(item));
+  if (values.empty()) throw std::invalid_argument(text);
+  return values;
+}
+
+size_t parseCount(const std::string &text) { return std::stoul(text); }
+double parseReal(const std::string &text) { return std::stod(text); }
+
+Neuron::Activation parseActivation(const std::string &text) {
+  for (auto activation :
+       {Neuron::Activation::Heaviside, Neuron::Activation::Sign,
+        Neuron::Activation::Logistic, Neuron::Activation::Tanh}) {
+    if (text == NeuralNetwork::Sweep::activationName(activation)) {
+      return activation;
+    }
+  }
+  throw std::invalid_argument(text);
+}
+
+NeuralNetwork::Optimizer::Method parseOptimizer(const std::string &text) {
+  using Method = NeuralNetwork::Optimizer::Method;
+  for (auto method :
+       {Method::SGD, Method::Momentum, Method::Nesterov, Method::Adam}) {
+    if (text == NeuralNetwork::Sweep::optimizerName(method)) return method;
+  }
+  throw std::invalid_argument(text);
+}
+
+bool parseOptions(int argc, char *argv[], Options &options) {
+  auto &space = options.space;
+  for (int i = 1; i < argc; ++i) {
+    const std::string name = argv[i];
+    if (name == "--help" || i + 1 >= argc) return false;
+    const char *value = argv[++i];
+    if (name == "--data") {
+      options.data = value;
+    } else if (name == "--inputs") {
+      options.inputs = std::stoul(value);
+    } else if (name == "--outputs") {
+      options.outputs = std::stoul(value);
+    } else if (name == "--validation") {
+      options.validation = std::stod(value);
+    } else if (name == "--layers") {
+      space.layers = parseList<size_t>(value, parseCount);
+    } else if (name == "--neurons") {
+      space.neurons = parseList<size_t>(value, parseCount);
+    } else if (name == "--activation") {
+      space.activations = parseList<Neuron::Activation>(value, parseActivation);
+    } else if (name == "--beta") {
+      space.betas = parseList<double>(value, parseReal);
+    } else if (name == "--eta") {
+      space.etas = parseList<double>(value, parseReal);
+    } else if (name == "--optimizer") {
+      space.optimizers =
+          parseList<NeuralNetwork::Optimizer::Method>(value, parseOptimizer);
+    } else if (name == "--batch") {
+      space.batch_sizes = parseList<size_t>(value, parseCount);
+    } else if (name == "--epochs") {
+      space.epochs = std::stoul(value);
+    } else if (name == "--epsilon") {
+      space.epsilon = std::stod(value);
+    } else if (name == "--seed") {
+      space.seed = std::stoull(value);
+    } else if (name == "--random") {
+      options.random = std::stoul(value);
+    } else if (name == "--threads") {
+      options.threads = std::stoul(value);
+    } else if (name == "--top") {
+      options.top = std::stoul(value);
+    } else if (name == "--format") {
+      options.format = value;
+    } else {
+      return false;
+    }
+  }
+  return !options.data.empty();
+}
+
+// the whole dataset in one store, the trainings share it read-only
+std::shared_ptr<const NeuralNetwork::SampleStore> load(const Options &options) {
+  auto reader =
+      NeuralNetwork::openDataset(options.data, options.inputs, options.outputs);
+  auto store = std::make_shared<NeuralNetwork::SampleStore>();
+  reader->read(reader->rows(), store->inputs, store->outputs);
+  return store;
+}
+
+void printCsv(const std::vector<NeuralNetwork::SweepResult> &results) {
+  std::printf(
+      "rank,layers,neurons,activation,beta,eta,optimizer,batch,epochs,"
+      "training_mse,validation_mse,validation_accuracy,cross_entropy,"
+      "seconds,error\n");
+  for (size_t r = 0; r < results.size(); ++r) {
+    const auto &result = results[r];
+    const auto &point = result.parameters;
+    // the error is quoted, its quotes doubled
+    std::string error;
+    for (char c : result.error) error += c == '"' ? "\"\"" : std::string(1, c);
+    std::printf("%zu,%zu,%zu,%s,%g,%g,%s,%zu,%zu,%g,%g,%g,%g,%.3f,\"%s\"\n",
+                r + 1, point.layers, point.neurons,
+                NeuralNetwork::Sweep::activationName(point.activation),
+                point.beta, point.eta,
+                NeuralNetwork::Sweep::optimizerName(point.optimizer),
+                point.batch_size, result.epochs, result.training_loss,
+                result.validation.mean_squared_error,
+                result.validation.accuracy, result.validation.cross_entropy,
+                result.seconds, error.c_str());
+  }
+}
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  try {
+    if (!parseOptions(argc, argv, options)) {
+      std::fprintf(
+          stderr,
+          "usage: %s --data FILE [--inputs I --outputs O] [--validation 0.2]"
+          " [--layers L,..] [--neurons N,..] [--activation logistic,tanh,..]"
+          " [--beta B,..] [--eta E,..] [--optimizer sgd,momentum,nesterov,"
+          "adam] [--batch B,..] [--epochs E] [--epsilon E] [--random N]"
+          " [--seed S] [--threads T] [--top N] [--format table|csv]\n",
+          argv[0]);
+      return 1;
+    }
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "invalid argument %s\n", e.what());
+    return 1;
+  }
+
+  try {
+    auto store = load(options);
+    NeuralNetwork::SampleView samples(store, options.space.seed);
+    samples.shuffle();
+    NeuralNetwork::SampleView training;
+    NeuralNetwork::SampleView validation;
+    std::tie(training, validation) = samples.split(1.0 - options.validation);
+    training.setShuffleEachEpoch(true);
+
+    const auto points = options.random ? options.space.random(options.random)
+                                       : options.space.grid();
+    std::fprintf(stderr, "%zu samples, %zu for validation, %zu trainings\n",
+                 store->size(), validation.size(), points.size());
+    NeuralNetwork::Sweep sweep(options.threads);
+    auto results = sweep.run(
+        points, training, validation,
+        [](const NeuralNetwork::SweepResult &, size_t done, size_t total) {
+          std::fprintf(stderr, "\r%zu/%zu", done, total);
+          return true;
+        });
+    std::fprintf(stderr, "\n");
+    if (options.top && results.size() > options.top) {
+      results.resize(options.top);
+    }
+    if (options.format == "csv") {
+      printCsv(results);
+    } else {
+      std::fputs(NeuralNetwork::Sweep::table(results).c_str(), stdout);
+    }
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,16 @@
+#-------------------------------------------------
+#
+# Headless hyperparameter sweep of the network core, no Qt required
+#
+#-------------------------------------------------
+
+TARGET = sweep
+TEMPLATE = app
+
+CONFIG += console c++14
+CONFIG -= qt app_bundle
+
+include(../core.pri)
+
+SOURCES += \
+        main.cpp
@@ -0,0 +1,77 @@
+#include "threadpool.h"
+
+NeuralNetwork::ThreadPool::ThreadPool(size_t threads) {
+  const size_t extra = threads > 1 ? threads - 1 : 0;
+  workers.reserve(extra);
+  for (size_t i = 0; i < extra; ++i) {
+    workers.emplace_back([this]() { work(); });
+  }
+}
+
+NeuralNetwork::ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto &worker : workers) worker.join();
+}
+
+void NeuralNetwork::ThreadPool::dispatch(size_t count, TaskRef task) {
+  if (!count) return;
+  if (workers.empty() || count == 1) {
+    for (size_t i = 0; i < count; ++i) task(i);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    current = task;
+    task_count = count;
+    busy = workers.size();
+    next.store(0, std::memory_order_relaxed);
+    ++generation;
+  }
+  wake.notify_all();
+  drain(task, count);
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [this]() { return busy == 0; });
+  if (failure) {
+    std::exception_ptr error = std::move(failure);
+    failure = nullptr;
+    lock.unlock();
+    std::rethrow_exception(error);
+  }
+}
+
+void NeuralNetwork::ThreadPool::drain(TaskRef task, size_t count) {
+  try {
+    for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+      task(i);
+    }
+  } catch (...) {
+    // an exception must not leave a worker, the first one is kept for the
+    // caller and the indices not handed out yet are skipped
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!failure) failure = std::current_exception();
+    next.store(count);
+  }
+}
+
+void NeuralNetwork::ThreadPool::work() {
+  size_t seen = 0;
+  for (;;) {
+    TaskRef task;
+    size_t count;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [this, seen]() { return stopping || generation != seen; });
+      if (stopping) return;
+      seen = generation;
+      task = current;
+      count = task_count;
+    }
+    drain(task, count);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (--busy == 0) done.notify_one();
+  }
+}
@@ -0,0 +1,62 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+namespace NeuralNetwork {
+// Fixed set of worker threads executing indexed tasks. run() hands out the
+// indices through an atomic counter and blocks until all of them are done,
+// the calling thread takes part in the work. A pool serves one run() at a
+// time. A task that throws stops the hand-out of the remaining indices,
+// run() rethrows the first exception once the running tasks are done.
+class ThreadPool {
+ public:
+  explicit ThreadPool(size_t threads = std::thread::hardware_concurrency());
+  ~ThreadPool();
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // number of threads taking part in run(), including the caller
+  size_t size() const { return workers.size() + 1; }
+  // calls task(i) for every i in [0, count), the task is referenced rather
+  // than copied into a std::function so handing it out never allocates
+  template <typename Task>
+  void run(size_t count, Task &&task) {
+    using Callable = typename std::remove_reference<Task>::type;
+    dispatch(count,
+             TaskRef{const_cast<void *>(static_cast<const void *>(&task)),
+                     [](void *object, size_t index) {
+                       (*static_cast<Callable *>(object))(index);
+                     }});
+  }
+
+ private:
+  struct TaskRef {
+    void *object;
+    void (*call)(void *, size_t);
+    void operator()(size_t index) const { call(object, index); }
+  };
+
+  void dispatch(size_t count, TaskRef task);
+  void work();
+  void drain(TaskRef task, size_t count);
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  TaskRef current{nullptr, nullptr};
+  size_t task_count{0};
+  size_t busy{0};
+  size_t generation{0};
+  bool stopping{false};
+  // first exception of the current run()
+  std::exception_ptr failure;
+  std::atomic<size_t> next{0};
+};
+}  // namespace NeuralNetwork
+#endif  // THREADPOOL_H